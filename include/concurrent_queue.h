@@ -10,6 +10,10 @@
 #include <iostream>
 #include <cassert>
 #include <cstring>
+#include <climits>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include "util.h"
 #include "machine.h"
@@ -31,30 +35,76 @@
 // (2) larger cache footprint of locking based queues. 
 // 
 
+// Iterations a parking SimpleQueue spins for before it sleeps on a futex.
+#define QUEUE_SPIN_ITERS (1<<14)
+
+static inline void
+futex_wait(volatile uint64_t *word, uint64_t expected) {
+        // Sleep on the low half of the word, as long as it is unchanged.
+        syscall(SYS_futex, (volatile uint32_t*)word, FUTEX_WAIT_PRIVATE, 
+                (uint32_t)expected, NULL, NULL, 0);
+}
+
+static inline void
+futex_wake(volatile uint64_t *word) {
+        syscall(SYS_futex, (volatile uint32_t*)word, FUTEX_WAKE_PRIVATE, 
+                INT_MAX, NULL, NULL, 0);
+}
+
 struct queue_elem {
     uint64_t m_data;						// Pointer to data (app specific).
     volatile struct queue_elem* m_next;
 } __attribute__((aligned(64)));
 
 
+//
+// If park is set, a blocked producer or consumer spins for QUEUE_SPIN_ITERS 
+// and then sleeps on a futex on the index it waits for. A thread about to 
+// sleep raises the waiters flag next to that index, and the other side wakes 
+// it after moving the index if the flag is up. Both sides use locked 
+// instructions between the two accesses, so one of them always sees the 
+// other's write.
+//
 template<class T>
 class SimpleQueue {
  public:
     char* m_values;
     uint64_t m_size;
+    bool m_park;
     volatile uint64_t __attribute__((__packed__, __aligned__(CACHE_LINE))) m_head;    
+    volatile uint64_t m_headWaiters;
     volatile uint64_t __attribute__((__packed__, __aligned__(CACHE_LINE))) m_tail;    
+    volatile uint64_t m_tailWaiters;
 
-    SimpleQueue(char* values, uint64_t size) {
+    SimpleQueue(char* values, uint64_t size, bool park = false) {
         m_values = values;
         m_size = (uint64_t)size;
+        m_park = park;
         assert(!(m_size & (m_size-1)));
         assert(sizeof(T) < CACHE_LINE);
         memset(values, 0x0, m_size*CACHE_LINE);
         m_head = 0;
         m_tail = 0;        
+        m_headWaiters = 0;
+        m_tailWaiters = 0;
         barrier();
     }
+
+    // Sleep until *index moves away from value.
+    void Park(volatile uint64_t *index, volatile uint64_t *waiters, 
+              uint64_t value) {
+        xchgq(waiters, 1);
+        if (*index == value)
+            futex_wait(index, value);
+    }
+
+    // Wake threads sleeping on index, called after index moved.
+    inline void Unpark(volatile uint64_t *index, volatile uint64_t *waiters) {
+        if (m_park && *waiters != 0) {
+            *waiters = 0;
+            futex_wake(index);
+        }
+    }
     
     uint64_t diff() {
         return m_tail - m_head;
@@ -76,6 +126,7 @@ class SimpleQueue {
             
             (*(T*)&m_values[index*CACHE_LINE]) = data;
             fetch_and_increment(&m_head);
+            Unpark(&m_head, &m_headWaiters);
             return true;
         }
     }
@@ -83,6 +134,7 @@ class SimpleQueue {
     void EnqueueBlocking(T data) {
             uint64_t head = m_head;
             uint64_t tail;
+            uint32_t spins = 0;
             assert(m_head >= m_tail);
             while (true) {
                     barrier();
@@ -90,6 +142,8 @@ class SimpleQueue {
                     barrier();
                     if (head < tail + m_size)
                             break;
+                    if (m_park && ++spins >= QUEUE_SPIN_ITERS) 
+                            Park(&m_tail, &m_tailWaiters, tail);
             }
             //        while (m_head == m_tail + m_size) 
             //            ;
@@ -98,10 +152,12 @@ class SimpleQueue {
         assert(index <= ((m_size - 1) << 6));
         (*(T*)&m_values[index*CACHE_LINE]) = data;
         fetch_and_increment(&m_head);
+        Unpark(&m_head, &m_headWaiters);
     }
     
     T DequeueBlocking() {
             uint64_t head, tail;
+            uint32_t spins = 0;
             tail = m_tail;
         assert(m_head >= m_tail);
         while (true) {
@@ -110,6 +166,8 @@ class SimpleQueue {
                 barrier();
                 if (head > tail)
                         break;
+                if (m_park && ++spins >= QUEUE_SPIN_ITERS) 
+                        Park(&m_head, &m_headWaiters, head);
         }
         //        while (m_head == m_tail) 
         //            ;
@@ -118,6 +176,7 @@ class SimpleQueue {
         assert(index <= ((m_size - 1) << 6));
         T ret = (*(T*)&m_values[index*CACHE_LINE]);
         fetch_and_increment(&m_tail);
+        Unpark(&m_tail, &m_tailWaiters);
         return ret;
     }
 
@@ -132,8 +191,252 @@ class SimpleQueue {
             assert(index <= ((m_size - 1) << 6));
             *value = (*(T*)&m_values[index*CACHE_LINE]);
             fetch_and_increment(&m_tail);
+            Unpark(&m_tail, &m_tailWaiters);
+            return true;
+        }
+    }
+};
+
+//
+// Bounded Chase-Lev work-stealing deque. The owning thread pushes and pops at 
+// the bottom without atomic instructions in the common case, while any number 
+// of thieves take elements from the top with a single cmpxchg. Only the pop 
+// of the last element races with thieves, and is settled by a cmpxchg on top.
+//
+// The deque does not grow. Push fails if the deque is full, in which case the 
+// owner is expected to consume the element itself.
+//
+template<class T>
+class WorkStealingDeque {
+ public:
+    T* m_values;
+    uint64_t m_size;
+    volatile uint64_t __attribute__((__packed__, __aligned__(CACHE_LINE))) m_top;
+    volatile uint64_t __attribute__((__packed__, __aligned__(CACHE_LINE))) m_bottom;
+
+    WorkStealingDeque(T* values, uint64_t size) {
+        m_values = values;
+        m_size = size;
+        assert(!(m_size & (m_size-1)));
+        m_top = 0;
+        m_bottom = 0;
+        barrier();
+    }
+
+    bool isEmpty() {
+        return (int64_t)(m_bottom - m_top) <= 0;
+    }
+
+    // Owner only.
+    bool Push(T data) {
+        uint64_t bottom = m_bottom;
+        barrier();
+        uint64_t top = m_top;
+        barrier();
+        if ((int64_t)(bottom - top) >= (int64_t)m_size)
+            return false;
+        m_values[bottom & (m_size-1)] = data;
+        barrier();
+        m_bottom = bottom + 1;
+        barrier();
+        return true;
+    }
+
+    // Owner only. Returns the most recently pushed element.
+    bool Pop(T* value) {
+        uint64_t bottom = m_bottom - 1;
+        m_bottom = bottom;
+        
+        // The store to bottom must be visible before top is read, otherwise 
+        // the owner and a thief can both take the last element.
+        asm volatile("mfence":::"memory");
+        uint64_t top = m_top;
+        if ((int64_t)(bottom - top) < 0) {
+            m_bottom = bottom + 1;
+            return false;
+        }
+        *value = m_values[bottom & (m_size-1)];
+        if (bottom != top) 
             return true;
+
+        // Last element, race with thieves for it.
+        bool success = cmp_and_swap(&m_top, top, top + 1);
+        barrier();
+        m_bottom = top + 1;
+        barrier();
+        return success;
+    }
+
+    // Any thread. Returns the least recently pushed element.
+    bool Steal(T* value) {
+        uint64_t top = m_top;
+        barrier();
+        uint64_t bottom = m_bottom;
+        barrier();
+        if ((int64_t)(bottom - top) <= 0)
+            return false;
+        T ret = m_values[top & (m_size-1)];
+        if (!cmp_and_swap(&m_top, top, top + 1))
+            return false;
+        *value = ret;
+        return true;
+    }
+    // Any thread. Like Steal, but leaves the element in place unless accept
+    // returns true for it. The element accept inspects is the one the cmpxchg
+    // takes, so the check can't race with the owner recycling the slot.
+    template<typename F>
+    bool StealIf(T* value, F accept) {
+        uint64_t top = m_top;
+        barrier();
+        uint64_t bottom = m_bottom;
+        barrier();
+        if ((int64_t)(bottom - top) <= 0)
+            return false;
+        T ret = m_values[top & (m_size-1)];
+        if (!accept(ret))
+            return false;
+        if (!cmp_and_swap(&m_top, top, top + 1))
+            return false;
+        *value = ret;
+        return true;
+    }
+};
+
+//
+// Bounded multi-producer/multi-consumer ring (after Vyukov). Producers and 
+// consumers claim runs of slots with a single cmpxchg on the head or tail, 
+// and each slot's sequence number hands the slot over between them: a slot 
+// at position p is free for the producer of p when its sequence is p, and 
+// holds p's element once its sequence is p+1. Claiming a run moves many 
+// elements per cmpxchg, and compact slots pack several elements into a 
+// cache line.
+//
+// values must hold size*SlotSize(compact) bytes.
+//
+template<class T>
+class MPMCQueue {
+ public:
+    struct Slot {
+        volatile uint64_t m_seq;
+        T m_value;
+    };
+
+    char* m_values;
+    uint64_t m_size;
+    uint64_t m_stride;
+    volatile uint64_t __attribute__((__packed__, __aligned__(CACHE_LINE))) m_head;
+    volatile uint64_t __attribute__((__packed__, __aligned__(CACHE_LINE))) m_tail;
+
+    static uint64_t SlotSize(bool compact) {
+        if (compact)
+            return sizeof(Slot);
+        return ((sizeof(Slot) + CACHE_LINE - 1) / CACHE_LINE) * CACHE_LINE;
+    }
+
+    MPMCQueue(char* values, uint64_t size, bool compact) {
+        m_values = values;
+        m_size = size;
+        m_stride = SlotSize(compact);
+        assert(!(m_size & (m_size-1)));
+        memset(values, 0x0, m_size*m_stride);
+        for (uint64_t i = 0; i < m_size; ++i)
+            GetSlot(i)->m_seq = i;
+        m_head = 0;
+        m_tail = 0;
+        barrier();
+    }
+
+    Slot* GetSlot(uint64_t pos) {
+        return (Slot*)&m_values[(pos & (m_size-1))*m_stride];
+    }
+
+    bool isEmpty() {
+        return m_head == m_tail;
+    }
+
+    // Enqueue up to n elements, returns the number enqueued.
+    uint32_t EnqueueMany(const T* data, uint32_t n) {
+        uint64_t head, tail, count, i;
+        Slot *slot;
+
+        while (true) {
+            barrier();
+            head = m_head;
+            barrier();
+            tail = m_tail;
+            barrier();
+            count = tail + m_size - head;
+            if (count > n)
+                count = n;
+            if (count == 0)
+                return 0;
+            if (cmp_and_swap(&m_head, head, head + count))
+                break;
+        }
+        
+        // The run is ours, but consumers of the previous lap may still be 
+        // reading some of its slots.
+        for (i = 0; i < count; ++i) {
+            slot = GetSlot(head + i);
+            while (slot->m_seq != head + i)
+                barrier();
+            slot->m_value = data[i];
+            barrier();
+            slot->m_seq = head + i + 1;
+        }
+        return (uint32_t)count;
+    }
+
+    // Dequeue up to n elements, returns the number dequeued.
+    uint32_t DequeueMany(T* data, uint32_t n) {
+        uint64_t head, tail, count, i;
+        Slot *slot;
+
+        while (true) {
+            barrier();
+            tail = m_tail;
+            barrier();
+            head = m_head;
+            barrier();
+            count = head - tail;
+            if (count > n)
+                count = n;
+            if (count == 0)
+                return 0;
+            if (cmp_and_swap(&m_tail, tail, tail + count))
+                break;
+        }
+
+        // Producers may not have finished writing the run yet.
+        for (i = 0; i < count; ++i) {
+            slot = GetSlot(tail + i);
+            while (slot->m_seq != tail + i + 1)
+                barrier();
+            data[i] = slot->m_value;
+            barrier();
+            slot->m_seq = tail + i + m_size;
         }
+        return (uint32_t)count;
+    }
+
+    bool Enqueue(T data) {
+        return EnqueueMany(&data, 1) == 1;
+    }
+
+    bool Dequeue(T* value) {
+        return DequeueMany(value, 1) == 1;
+    }
+
+    void EnqueueBlocking(T data) {
+        while (!Enqueue(data))
+            do_pause();
+    }
+
+    T DequeueBlocking() {
+        T ret;
+        while (!Dequeue(&ret))
+            do_pause();
+        return ret;
     }
 };
 
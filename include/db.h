@@ -86,6 +86,11 @@ class translator {
         virtual void *write_ref(uint64_t key, uint32_t table) = 0;
         virtual void *read(uint64_t key, uint32_t table) = 0;
         virtual int rand() = 0;
+
+        // The txn won't touch the record at key again. Engines which can 
+        // release its lock early override this.
+        virtual void release(__attribute__((unused)) uint64_t key, 
+                             __attribute__((unused)) uint32_t table) {};
         virtual ~translator(){};
 };
 
@@ -102,6 +107,7 @@ class txn {
         void* get_write_ref(uint64_t key, uint32_t table_id);
         void* get_read_ref(uint64_t key, uint32_t table_id);
         void* get_insert_ref(uint64_t key, uint32_t table_id);
+        void release_ref(uint64_t key, uint32_t table_id);
         int txn_rand();
         
  public:
@@ -8,6 +8,7 @@
 #include <cpuinfo.h>
 #include <runnable.hh>
 #include <record_buffer.h>
+#include <latency_histogram.h>
 
 struct locking_action_batch {
   uint32_t batchSize;
@@ -33,8 +34,12 @@ private:
   int         m_num_elems;                    // Number of elements in the queue
 
   volatile uint32_t m_num_done;
+  uint64_t m_num_aborts;                    // Lock policy aborts
 
   RecordBuffers *bufs;
+
+  // Cycles from the start of each txn until it releases its locks
+  LatencyHistogram latencies;
   
   // Worker thread function
   virtual void WorkerFunction();
@@ -69,6 +74,14 @@ public:
   uint32_t NumProcessed() {
     return m_num_done;
   }
+
+  uint64_t NumAborts() {
+    return m_num_aborts;
+  }
+
+  LatencyHistogram* Latencies() {
+    return &latencies;
+  }
 };
 
 #endif           // LOCKING_WORKER_HH_
@@ -5,7 +5,9 @@
 #include <mv_record.h>
 #include <database.h>
 #include <set>
+#include <vector>
 #include <common_constants.h>
+#include <latency_histogram.h>
 
 struct ActionListNode {
   mv_action *action;
@@ -42,13 +44,20 @@ class GarbageBin {
 
   // curStickies and curRecords correspond to "live" queues, in which new 
   // garbage is thrown
-  MVRecordList *curStickies;
+  std::vector<MVRecord*> *curStickies;
   RecordList *curRecords;
   
   // snapshotStickies and snapshotRecords correspond to a snapshot as of a 
   // specific epoch
-  MVRecordList *snapshotStickies;
+  std::vector<MVRecord*> *snapshotStickies;
   RecordList *snapshotRecords;
+
+  // Versions past the low watermark, linked through allocLink, which are yet
+  // to be handed back to their CC threads. Versions are only linked once they
+  // get here, because a superseded version's link (which shares its word with
+  // allocLink) may still be followed by readers walking a hash chain until 
+  // the low watermark passes it.
+  MVRecordList *readyStickies;
   uint32_t snapshotEpoch;
 
   GarbageBinConfig config;
@@ -127,9 +136,34 @@ struct ExecutorConfig {
         uint32_t numQueuesPerTable;
         SimpleQueue<RecordList> *recycleQueues;
         GarbageBinConfig garbageConfig;
+
+        /* 
+         * Per-executor deques of actions yet to be run, indexed by threadId. 
+         * NULL unless executors steal work from each other.
+         */
+        WorkStealingDeque<mv_action*> **deques;
+
+        /* 
+         * NUMA node of each CC thread's records, indexed by CC threadId. NULL 
+         * unless records are homed by partition. Actions routed to this 
+         * thread's node are striped across the node's nodeExecutors 
+         * executors, of which this thread is number nodeRank.
+         */
+        int *partitionNodes;
+        int node;
+        uint32_t nodeRank;
+        uint32_t nodeExecutors;
+
+        /* 
+         * Every table's partitions, indexed by tableId, used to look up the 
+         * versions read by snapshot reads. NULL unless snapshot reads are on.
+         */
+        MVTable **tables;
 };
 
 class Executor : public Runnable {
+        friend class ExecutorTest;
+
  private:
         ExecutorConfig config;
         GarbageBin *garbageBin;
@@ -142,6 +176,29 @@ class Executor : public Runnable {
         PendingActionList *pendingGC;
         uint64_t counter;
 
+        /* Cycles spent waiting for the next batch from the schedulers. */
+        volatile uint64_t idleCycles;
+
+        /* Record accesses on this thread's NUMA node, and on other nodes. */
+        uint64_t localAccesses;
+        uint64_t remoteAccesses;
+
+        /* 
+         * Cycles from the start of each action's batch at the CC stage until 
+         * the action is substantiated. 
+         */
+        LatencyHistogram latencies;
+
+        /* 
+         * Blocked actions are parked on the action they wait for, and handed 
+         * back through readyList, a stack of actions pushed by the threads 
+         * which substantiated their blockers. numWaiting counts actions parked
+         * this way. Actions which could not be parked are polled on 
+         * pendingList.
+         */
+        uint32_t numWaiting;
+        volatile uint64_t __attribute__((aligned(CACHE_LINE))) readyList;
+
  protected:
 
         //  Executor(ExecutorConfig config);
@@ -150,19 +207,35 @@ class Executor : public Runnable {
         void ReturnVersion(MVRecord *record);
 
         void ExecPending();
+        uint32_t NumPending();
+        void ParkAction(mv_action *action, mv_action *blocker);
+        bool AddWaiter(mv_action *blocker, mv_action *action);
+        void WakeWaiters(mv_action *action);
+        void PushReady(mv_action *action);
+
+        uint32_t FirstAction(const ActionBatch &batch, uint32_t *rank);
+        uint32_t NextAction(const ActionBatch &batch, uint32_t i, 
+                            uint32_t *rank);
+        uint32_t FindRouted(const ActionBatch &batch, uint32_t i, 
+                            uint32_t *rank);
+        void CountAccesses(mv_action *action);
 
         void ProcessBatch(const ActionBatch &batch);
-        bool ProcessSingle(mv_action *action);
-        bool ProcessTxn(mv_action *action);
+        void ProcessBatchStealing(const ActionBatch &batch);
+        void ProcessSnapshots(const ActionBatch &batch);
+        bool StealAction(mv_action **action, uint32_t epoch);
+        bool ProcessSingle(mv_action *action, mv_action **blocker = NULL);
+        bool ProcessTxn(mv_action *action, mv_action **blocker);
 
         bool run_readonly(mv_action *action);
+        bool run_snapshot(mv_action *action, mv_action **blocker);
         void RecycleData();
 
         void adjust_lowwatermark();
 
         uint32_t DoPendingGC();
         bool ProcessSingleGC(mv_action *action);
-        bool check_ready(mv_action *action);
+        bool check_ready(mv_action *action, mv_action **blocker);
 
  public:
         void* operator new(std::size_t sz, int cpu) {
@@ -170,6 +243,22 @@ class Executor : public Runnable {
         }
 
         Executor(ExecutorConfig config);
+
+        uint64_t IdleCycles() {
+                return idleCycles;
+        }
+
+        uint64_t LocalAccesses() {
+                return localAccesses;
+        }
+
+        uint64_t RemoteAccesses() {
+                return remoteAccesses;
+        }
+
+        LatencyHistogram* Latencies() {
+                return &latencies;
+        }
 };
 
 #endif          // EXECUTOR_H_
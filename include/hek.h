@@ -4,9 +4,13 @@
 #include <concurrent_queue.h>
 #include <hek_action.h>
 #include <runnable.hh>
+#include <latency_histogram.h>
 
 class hek_table;
 
+/* Max dependency results handled per dequeue from a commit/abort queue. */
+#define HEK_DEPENDENT_BATCH 32
+
 class hek_queue {
         volatile hek_action *head;
         volatile hek_action **tail;
@@ -41,8 +45,11 @@ struct hek_worker_config {
         hek_table **tables;
         SimpleQueue<hek_batch> *input_queue;
         SimpleQueue<hek_batch> *output_queue;
-        SimpleQueue<hek_action*> **commit_queues;
-        SimpleQueue<hek_action*> **abort_queues;
+
+        // Results of the commit dependencies of this worker's txns, 
+        // enqueued by the workers which commit or abort the dependencies.
+        MPMCQueue<hek_action*> *commit_queue;
+        MPMCQueue<hek_action*> *abort_queue;
         //        hek_queue *commit_queue;
         //        hek_queue *abort_queue;
         uint64_t *free_list_sizes;
@@ -58,6 +65,9 @@ class hek_worker : public Runnable {
         
         struct hek_record **records;
 
+        /* Cycles from the first attempt of each txn until it commits. */
+        LatencyHistogram latencies;
+
         virtual void init_allocator();
         virtual struct hek_record* get_new_record(uint32_t table_id);
         //        virtual void return_record(uint32_t table_id,
@@ -110,6 +120,11 @@ class hek_worker : public Runnable {
         
         hek_worker(hek_worker_config conf);
 
+        LatencyHistogram* Latencies()
+        {
+                return &latencies;
+        }
+
 
 };
 
@@ -71,8 +71,12 @@ class hek_action : public translator {
         bool must_wait;
         bool readonly;
 
+        /* Start of the first attempt since the last commit, 0 if none. */
+        uint64_t start_time;
+
  	hek_action(txn *t) : translator(t) {
                 readonly = false;
+                start_time = 0;
         };
         
         virtual hek_status Run();
@@ -0,0 +1,60 @@
+#ifndef LATENCY_HISTOGRAM_H_
+#define LATENCY_HISTOGRAM_H_
+
+#include <stdint.h>
+#include <cassert>
+#include <ostream>
+
+/*
+ * Values below LATENCY_SUB_BUCKETS get a bucket each. Above that, every power
+ * of two range is split into LATENCY_SUB_BUCKETS equal buckets, so a bucket
+ * is within 1/LATENCY_SUB_BUCKETS of the values it holds.
+ */
+#define LATENCY_SUB_BITS 5
+#define LATENCY_SUB_BUCKETS (1<<LATENCY_SUB_BITS)
+#define LATENCY_BUCKETS ((64-LATENCY_SUB_BITS+1)*LATENCY_SUB_BUCKETS)
+
+/*
+ * Log-linear (HDR-style) histogram of latencies in cycles. Each thread records
+ * into its own histogram, which are merged once the experiment is done.
+ */
+class LatencyHistogram {
+ private:
+        uint64_t counts[LATENCY_BUCKETS];
+        uint64_t total;
+
+        static inline uint32_t BucketOf(uint64_t value)
+        {
+                uint32_t shift;
+
+                if (value < LATENCY_SUB_BUCKETS)
+                        return (uint32_t)value;
+                shift = 63 - __builtin_clzll(value) - LATENCY_SUB_BITS;
+                return (shift+1)*LATENCY_SUB_BUCKETS +
+                        (uint32_t)((value >> shift) & (LATENCY_SUB_BUCKETS-1));
+        }
+
+        static uint64_t BucketValue(uint32_t bucket);
+
+ public:
+        LatencyHistogram();
+
+        /* Only the owning thread records. */
+        inline void Record(uint64_t cycles)
+        {
+                counts[BucketOf(cycles)] += 1;
+                total += 1;
+        }
+
+        void Reset();
+        void Merge(const LatencyHistogram &other);
+        uint64_t Count() { return total; }
+
+        /* Latency in cycles below which pct percent of the values lie. */
+        uint64_t Percentile(double pct);
+
+        /* Write "p50:w p90:x p99:y p99.9:z " in microseconds, prefixed. */
+        void WritePercentiles(std::ostream &out, const char *prefix = "");
+};
+
+#endif // LATENCY_HISTOGRAM_H_
@@ -13,7 +13,11 @@ class LockManager {
  private:
         LockManagerTable *table;
         uint64_t *tableSizes;
+        lock_policy policy;
+        bool early_release;
+        volatile uint64_t next_timestamp;
 
+        void WaitDependencies(locking_action *txn);
 
 public:
     LockManager(LockManagerConfig config);
@@ -22,6 +26,13 @@ public:
     static bool SortCmp(const locking_key &key1, const locking_key &key2);
     bool LockRecord(locking_action *txn, struct locking_key *dep);
     void BlockingLockRecord(locking_action *txn, struct locking_key *dep);
+    void Begin(locking_action *txn);
+    void AcquireRecord(locking_action *txn, struct locking_key *dep);
+    void ReleaseEarly(locking_action *txn, struct locking_key *dep);
+
+    bool EarlyRelease() {
+            return early_release;
+    }
 };
 
 #endif // LOCK_MANAGER_HH_
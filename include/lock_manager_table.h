@@ -8,17 +8,56 @@
 #include <lock_manager.h>
 #include <locking_action.h>
 
+/*
+ * Lock state of a single key, used if LockManagerConfig::keyHeaders is set. 
+ * The header counts the current holders, and queues waiting requests in FIFO 
+ * order, so granting and releasing a lock doesn't scan other keys' requests.
+ */
+struct LockHeader {
+        uint64_t key;
+        uint32_t table_id;
+        uint32_t num_readers;
+        bool writer;
+        uint64_t min_timestamp;         /* Oldest requester since reuse */
+        locking_action *releaser;       /* Last txn to release early */
+        locking_key *head;
+        locking_key *tail;
+        LockHeader *next;
+};
+
 struct LockBucket {
         locking_key *head;
         locking_key *tail;
-        volatile uint64_t latch;
+        volatile uint64_t latch;        /* Spinlock, or MCS tail if mcsLatch */
+        LockHeader *headers;            /* Headers of keys with requests */
+        LockHeader *free_headers;       /* Idle headers, for reuse */
 } __attribute__((__packed__, __aligned__(CACHE_LINE)));
 
+/*
+ * What a lock request does if it conflicts with an earlier request. Under 
+ * LOCK_NO_WAIT and LOCK_WAIT_DIE, txns may acquire locks in any order.
+ */
+enum lock_policy {
+        LOCK_WAIT = 0,          /* Always wait, txns lock keys in sorted order */
+        LOCK_NO_WAIT,           /* Never wait, the requester aborts */
+        LOCK_WAIT_DIE,          /* Wait only if older than the other requests */
+};
+
+enum lock_status {
+        LOCK_GRANTED,
+        LOCK_QUEUED,
+        LOCK_DENIED,
+};
+
 struct LockManagerConfig {
   uint32_t numTables;
   uint32_t *tableSizes;
   int startCpu;
   int endCpu;
+  bool keyHeaders;
+  lock_policy policy;
+  bool mcsLatch;
+  bool earlyRelease;
 };
 
 class LockManagerTable {
@@ -28,6 +67,8 @@ class LockManagerTable {
   uint64_t *tableSizes;
   int startCpu;
   int endCpu;
+  bool keyHeaders;
+  bool mcsLatch;
 
   static const uint64_t BUCKET_SIZE = CACHE_LINE;
 
@@ -49,6 +90,26 @@ class LockManagerTable {
           return (LockBucket*)bucketPtr;
   }
 
+  /*
+   * Under contention, the MCS latch hands the bucket over in FIFO order, and 
+   * each waiter spins on its own node rather than on the bucket's cache line.
+   */
+  void LatchBucket(LockBucket *bucket, struct mcs_node *me)
+  {
+          if (mcsLatch)
+                  mcs_lock(&bucket->latch, me);
+          else
+                  lock(&bucket->latch);
+  }
+
+  void UnlatchBucket(LockBucket *bucket, struct mcs_node *me)
+  {
+          if (mcsLatch)
+                  mcs_unlock(&bucket->latch, me);
+          else
+                  unlock(&bucket->latch);
+  }
+
   /*
    * Find the next locking_key on the same key as k. Returns true if we're able 
    * to find a descendant, otherwise, return false.
@@ -218,12 +279,197 @@ class LockManagerTable {
                   (bucket->head != NULL && bucket->tail != NULL));
   }
 
+  /*
+   * Find the header of k's key in the bucket, create one if there isn't any.
+   */
+  LockHeader* GetHeader(locking_key *k, LockBucket *bucket)
+  {
+          LockHeader *hdr;
+
+          for (hdr = bucket->headers; hdr != NULL; hdr = hdr->next) 
+                  if (hdr->key == k->key && hdr->table_id == k->table_id)
+                          return hdr;
+          if (bucket->free_headers != NULL) {
+                  hdr = bucket->free_headers;
+                  bucket->free_headers = hdr->next;
+          } else {
+                  hdr = (LockHeader*)malloc(sizeof(LockHeader));
+                  assert(hdr != NULL);
+          }
+          hdr->key = k->key;
+          hdr->table_id = k->table_id;
+          hdr->num_readers = 0;
+          hdr->writer = false;
+          hdr->min_timestamp = ~((uint64_t)0);
+          hdr->releaser = NULL;
+          hdr->head = NULL;
+          hdr->tail = NULL;
+          hdr->next = bucket->headers;
+          bucket->headers = hdr;
+          return hdr;
+  }
+
+  /*
+   * hdr's key has no holders and no waiters, move hdr to the free list.
+   */
+  void PutHeader(LockHeader *hdr, LockBucket *bucket)
+  {
+          LockHeader **iter;
+          
+          assert(hdr->num_readers == 0 && hdr->writer == false);
+          assert(hdr->head == NULL && hdr->tail == NULL);
+          for (iter = &bucket->headers; *iter != hdr; iter = &(*iter)->next) 
+                  assert(*iter != NULL);
+          *iter = hdr->next;
+          hdr->next = bucket->free_headers;
+          bucket->free_headers = hdr;
+  }
+
+  /*
+   * Check whether k can be granted given the holders of hdr.
+   */
+  bool Compatible(LockHeader *hdr, locking_key *k)
+  {
+          if (k->is_write)
+                  return hdr->writer == false && hdr->num_readers == 0;
+          else
+                  return hdr->writer == false;
+  }
+
+  /*
+   * If the key was released early by a txn which hasn't committed yet, k's 
+   * txn may see its writes, and must not commit before it.
+   */
+  void Grant(LockHeader *hdr, locking_key *k)
+  {
+          locking_action *releaser = hdr->releaser;
+
+          if (k->is_write)
+                  hdr->writer = true;
+          else
+                  hdr->num_readers += 1;
+          if (releaser != NULL && releaser != k->dependency && 
+              releaser->committed == false)
+                  k->dependency->commit_deps.push_back(releaser);
+  }
+
+  /*
+   * Hand hdr's lock to waiters at the head of its queue, as long as they're 
+   * compatible with the remaining holders.
+   */
+  void GrantWaiters(LockHeader *hdr)
+  {
+          locking_key *k;
+
+          while ((k = hdr->head) != NULL && Compatible(hdr, k)) {
+                  hdr->head = k->next;
+                  if (hdr->head == NULL)
+                          hdr->tail = NULL;
+                  k->next = NULL;
+                  Grant(hdr, k);
+                  pass_lock(k);
+          }
+  }
+
+  /*
+   * Check whether a conflicting request on k's key may wait under policy. 
+   * Under LOCK_WAIT_DIE, k waits only if its txn is older than the txns of all 
+   * other requests on the key.
+   */
+  bool MayWait(locking_key *k, LockBucket *bucket, lock_policy policy)
+  {
+          locking_key *iter;
+          uint64_t timestamp;
+
+          if (policy == LOCK_WAIT)
+                  return true;
+          else if (policy == LOCK_NO_WAIT)
+                  return false;
+          timestamp = k->dependency->timestamp;
+          for (iter = bucket->head; iter != NULL; iter = iter->next) 
+                  if (iter != k && *iter == *k && 
+                      iter->dependency->timestamp < timestamp)
+                          return false;
+          return true;
+  }
+
+  /*
+   * Header mode counterpart of AppendInfo+check_conflict. A request is 
+   * granted only if no one is waiting ahead of it, so waiters are FIFO. 
+   *
+   * The header doesn't know which txns hold the lock, so LOCK_WAIT_DIE 
+   * compares against the oldest requester since the header was last idle. 
+   * That's conservative: a requester may die when waiting would have been 
+   * safe, but never waits for an older txn.
+   */
+  lock_status HeaderLock(locking_key *key, LockBucket *bucket, 
+                         lock_policy policy)
+  {
+          LockHeader *hdr;
+          uint64_t timestamp;
+
+          hdr = GetHeader(key, bucket);
+          timestamp = key->dependency->timestamp;
+          key->next = NULL;
+          if (hdr->head == NULL && Compatible(hdr, key)) {
+                  Grant(hdr, key);
+                  key->header = hdr;
+                  key->is_held = true;
+                  if (timestamp < hdr->min_timestamp)
+                          hdr->min_timestamp = timestamp;
+                  return LOCK_GRANTED;
+          }
+          if (policy == LOCK_NO_WAIT || 
+              (policy == LOCK_WAIT_DIE && hdr->min_timestamp < timestamp))
+                  return LOCK_DENIED;
+          key->header = hdr;
+          if (timestamp < hdr->min_timestamp)
+                  hdr->min_timestamp = timestamp;
+          if (hdr->tail == NULL)
+                  hdr->head = key;
+          else
+                  hdr->tail->next = key;
+          hdr->tail = key;
+          key->is_held = false;
+          fetch_and_increment(&key->dependency->num_dependencies);
+          return LOCK_QUEUED;
+  }
+
+  /*
+   * The header has to outlive an uncommitted early releaser, so later 
+   * requests on the key still pick up the commit dependency.
+   */
+  void HeaderUnlock(locking_key *k, LockBucket *bucket, bool early)
+  {
+          LockHeader *hdr = k->header;
+
+          assert(hdr != NULL && hdr->key == k->key && 
+                 hdr->table_id == k->table_id);
+          if (k->is_write) {
+                  assert(hdr->writer == true && hdr->num_readers == 0);
+                  hdr->writer = false;
+          } else {
+                  assert(hdr->writer == false && hdr->num_readers > 0);
+                  hdr->num_readers -= 1;
+          }
+          k->header = NULL;
+          if (early)
+                  hdr->releaser = k->dependency;
+          GrantWaiters(hdr);
+          if (hdr->writer == false && hdr->num_readers == 0 && 
+              hdr->head == NULL &&
+              (hdr->releaser == NULL || hdr->releaser->committed == true))
+                  PutHeader(hdr, bucket);
+  }
+
  public:
   
   LockManagerTable(LockManagerConfig config)
   {
           this->startCpu = config.startCpu;
           this->endCpu = config.endCpu;
+          this->keyHeaders = config.keyHeaders;
+          this->mcsLatch = config.mcsLatch;
           this->tableSizes =
                   (uint64_t*)malloc(sizeof(uint64_t)*config.numTables);
           for (uint32_t i = 0; i < config.numTables; ++i) 
@@ -282,36 +528,68 @@ class LockManagerTable {
   }
 
   /*
-   * Try to acquire the logical lock requested by key. Returns true if the lock 
-   * is immediately acquired, otherwise, return false.
+   * Try to acquire the logical lock requested by key. If it conflicts with 
+   * earlier requests, policy decides whether key waits for them (LOCK_QUEUED, 
+   * its txn gets a dependency) or is dropped (LOCK_DENIED).
    */
-  bool Lock(locking_key *key)
+  lock_status TryLock(locking_key *key, lock_policy policy)
   {
-          bool conflict;
+          lock_status status;
           LockBucket *bucket;
+          struct mcs_node me;
 
           bucket = GetBucketRef(key);
-          lock(&bucket->latch);
-          AppendInfo(key, bucket);
-          conflict = check_conflict(key);
-          unlock(&bucket->latch);
-          return !conflict;
+          LatchBucket(bucket, &me);
+          if (keyHeaders) {
+                  status = HeaderLock(key, bucket, policy);
+          } else {
+                  AppendInfo(key, bucket);
+                  if (check_conflict(key) == false) {
+                          status = LOCK_GRANTED;
+                  } else if (MayWait(key, bucket, policy)) {
+                          status = LOCK_QUEUED;
+                  } else {
+                          RemoveInfo(key, bucket);
+                          fetch_and_decrement(&key->dependency->
+                                              num_dependencies);
+                          status = LOCK_DENIED;
+                  }
+          }
+          UnlatchBucket(bucket, &me);
+          return status;
+  }
+
+  /*
+   * Try to acquire the logical lock requested by key. Returns true if the lock 
+   * is immediately acquired, otherwise, return false.
+   */
+  bool Lock(locking_key *key)
+  {
+          return TryLock(key, LOCK_WAIT) == LOCK_GRANTED;
   }
 
   /*
-   * Release the logical lock held by k.
+   * Release the logical lock held by k. If early is set, k's txn hasn't 
+   * committed yet, only the per-key header layout supports that.
    */
-  void Unlock(locking_key *k)
+  void Unlock(locking_key *k, bool early = false)
   {
           assert(k->is_held);
           LockBucket *bucket = GetBucketRef(k);    
-          lock(&bucket->latch);
-          if (k->is_write) 
-                  AdjustWrite(k);
-          else 
-                  AdjustRead(k, bucket);
-          RemoveInfo(k, bucket);
-          unlock(&bucket->latch);
+          struct mcs_node me;
+          LatchBucket(bucket, &me);
+          assert(keyHeaders || !early);
+          if (keyHeaders) {
+                  HeaderUnlock(k, bucket, early);
+          } else {
+                  if (k->is_write) 
+                          AdjustWrite(k);
+                  else 
+                          AdjustRead(k, bucket);
+                  RemoveInfo(k, bucket);
+          }
+          k->is_held = false;
+          UnlatchBucket(bucket, &me);
     }
 };
 
@@ -4,6 +4,7 @@
 #include <db.h>
 #include <table.h>
 #include <vector>
+#include <exception>
 #include <machine.h>
 #include <record_buffer.h>
 
@@ -11,6 +12,11 @@ class locking_action;
 class lock_manager_table;
 class locking_worker;
 class LockManager;
+struct LockHeader;
+
+/* Thrown when the lock policy refuses to let a txn wait for a lock. */
+class locking_abort_exception : public std::exception {
+};
 
 struct locking_key {
 
@@ -26,6 +32,7 @@ public:
         volatile uint64_t *latch;
         struct locking_key *prev;
         struct locking_key *next;
+        struct LockHeader *header;
         bool is_initialized;
         void *value;
 
@@ -101,12 +108,24 @@ class locking_action : public translator {
         uint32_t read_index;
         uint32_t write_index;
         bool finished_execution;
+        uint64_t timestamp;             /* Wait-die priority, lower is older */
         RecordBuffers *bufs;
         
         std::vector<locking_key> writeset;
         std::vector<locking_key> readset;        
 
+        /* 
+         * Early lock release. Keys the txn is done with are released once it 
+         * holds all of its locks, until then they wait in "finished". 
+         */
+        uint32_t num_acquired;
+        std::vector<locking_key*> finished;
+        std::vector<locking_action*> commit_deps;
+        volatile bool committed;
+
         void commit_writes(bool commit);
+        void acquired();
+        void release_key(locking_key *k);
         void* lookup(locking_key *key);
         
         int find_key(uint64_t key, uint32_t table_id,
@@ -119,6 +138,7 @@ class locking_action : public translator {
 
         void* write_ref(uint64_t key, uint32_t table_id);
         void* read(uint64_t key, uint32_t table_id);
+        void release(uint64_t key, uint32_t table_id);
         int rand();
         void prepare();
         bool Run();
@@ -9,6 +9,7 @@
 #define MV_EPOCH_MASK 0xFFFFFFFF00000000
 #define GET_MV_EPOCH(timestamp) (timestamp & MV_EPOCH_MASK)
 #define CREATE_MV_TIMESTAMP(epoch, timestamp) ((((uint64_t)epoch)<<32) | timestamp)
+#define MV_WAITERS_CLOSED 0x1
 
 extern uint32_t NUM_CC_THREADS;
 
@@ -21,9 +22,40 @@ struct key_index {
 class mv_action;
 class Executor;
 
+/* 
+ * Reference to a key of the action at actionIndex of a batch. keyIndex indexes
+ * the action's writeset if MV_WRITE_REF is set, and its readset otherwise. 
+ */
+#define MV_WRITE_REF 0x80000000
+
+struct MVKeyRef {
+        uint32_t actionIndex;
+        uint32_t keyIndex;
+};
+
+/* The keys of a batch owned by a single concurrency control thread. */
+struct MVKeyRefList {
+        MVKeyRef *refs;
+        uint32_t count;
+};
+
 struct ActionBatch {
     mv_action **actionBuf;
     uint32_t numActions;
+
+    // If the batch went through an MVActionHasher, the batch's keys sorted by 
+    // concurrency control thread, indexed by threadId. Otherwise NULL.
+    MVKeyRefList *threadKeys;
+
+    // NUMA node each action should run on, or NULL if actions are not routed.
+    uint8_t *homeNodes;
+
+    // Snapshot reads which run alongside the batch, but are not scheduled.
+    mv_action **readOnlyBuf;
+    uint32_t numReadOnly;
+
+    // Cycle count at which the leader CC thread started on the batch.
+    uint64_t startTime;
 };
 
 enum ActionState {
@@ -186,11 +218,27 @@ class mv_action : public translator {
         CompositeKey GenerateKey(bool is_rmw, uint32_t tableId, uint64_t key);
         Executor *exec;
         bool init;
+
+        /* 
+         * Dependency-driven wakeup. waiters is a stack (linked through 
+         * next_waiter) of actions blocked on this one. It is closed with 
+         * MV_WAITERS_CLOSED once this action is substantiated. parked_on is 
+         * the executor to hand a blocked action back to once it can run.
+         */
+        volatile uint64_t waiters;
+        mv_action *next_waiter;
+        Executor *parked_on;
         
  public:
         uint64_t __version;
         uint64_t __combinedHash;
         bool __readonly;
+
+        /* 
+         * Read-only action which bypasses the schedulers, and reads the 
+         * versions which precede its epoch straight from the partitions. 
+         */
+        bool __snapshot;
         std::vector<int> __write_starts;
         std::vector<int> __read_starts;
         std::vector<CompositeKey> __readset;
@@ -198,6 +246,13 @@ class mv_action : public translator {
         
         volatile uint64_t __attribute__((aligned(CACHE_LINE))) __state;
 
+        /* 
+         * Cycle count at which the leader CC thread started on the action's 
+         * batch. Dependencies may run as part of a later batch, so latencies
+         * are measured from here rather than from the running batch's start.
+         */
+        uint64_t start_time;
+
         mv_action(txn *t);
 
         void setup_reverse_index();
@@ -7,18 +7,28 @@
 #include <cpuinfo.h>
 #include <iostream>
 #include <common_constants.h>
+#include <machine.h>
 
 class mv_action;
 class Record;
 
 typedef struct _MVRecord_ MVRecord;
 
+/*
+ * A single version of a record. Versions are exactly one cache line. The first
+ * half holds the fields touched while walking a key's version chain 
+ * (timestamps, key and the link to the previous version); the second half is 
+ * only touched once the right version has been found, or by index, allocator 
+ * and garbage collection bookkeeping.
+ */
 struct _MVRecord_ {
   
         static uint64_t INFINITY;        
 
+        /* Hot: read on every step of a version chain walk. */
         uint64_t createTimestamp;
         uint64_t deleteTimestamp;
+        MVRecord *recordLink;
         uint64_t key;
         
         // The transaction responsible for creating a value associated with the 
@@ -28,13 +38,20 @@ struct _MVRecord_ {
         // The actual value of the record.
         Record *value;        
 
-        MVRecord *link;        
-        MVRecord *recordLink;
         MVRecord *epoch_ancestor;
-        MVRecord *allocLink;
 
-        uint32_t writingThread;
-} __attribute__((__packed__));
+        /* 
+         * Cold. A version is only added to a partition's hash chain (link) 
+         * while it is the latest version of its key, but readers which were
+         * walking the chain when it was superseded may still follow its link.
+         * The garbage collector therefore only links it into a free list
+         * (allocLink) once the low watermark has passed it, see GarbageBin.
+         */
+        union {
+                MVRecord *link;
+                MVRecord *allocLink;
+        };
+} __attribute__((__aligned__(CACHE_LINE)));
 
 /*
  * MVRecords are returned to the allocator (defined below) in bulk using this 
@@ -66,8 +83,10 @@ class MVRecordAllocator {
   };
         
   // Constructor takes a size parameter, which is the total number of bytes 
-  // allocator can work with.
-  MVRecordAllocator(uint64_t size, int cpu, int worker_start, int worker_end);
+  // allocator can work with. Record data is allocated on recordCpu's NUMA 
+  // node, or interleaved across all nodes if recordCpu is negative.
+  MVRecordAllocator(uint64_t size, int cpu, int worker_start, int worker_end,
+                    int recordCpu = -1);
         
   // 
   bool GetRecord(MVRecord **out);
@@ -4,6 +4,30 @@
 #include <mv_record.h>
 #include <mv_action.h>
 
+#define MV_BUCKET_ENTRIES 4
+#define MV_LOOKUP_BATCH 32
+
+/*
+ * Layout of a partition's key index. MV_CHAINED_INDEX hangs every key off a 
+ * slot through MVRecord::link. MV_BUCKET_INDEX stores (key, latest version) 
+ * pairs inline in cache line sized buckets, and probes linearly across 
+ * buckets, so a lookup costs a single miss in the common case.
+ */
+enum MVIndexType {
+        MV_CHAINED_INDEX = 0,
+        MV_BUCKET_INDEX = 1,
+};
+
+/* 
+ * A bucket of the open-addressed index. An entry is free iff its head pointer 
+ * is NULL. Keys are never removed from a partition, so probing stops at the 
+ * first free entry.
+ */
+struct MVIndexBucket {
+        uint64_t keys[MV_BUCKET_ENTRIES];
+        MVRecord *heads[MV_BUCKET_ENTRIES];
+} __attribute__((__aligned__(CACHE_LINE)));
+
 
 /*
  * Single-writer hash table. Each scheduler thread contains a unique 
@@ -13,8 +37,22 @@ class MVTablePartition {
         
  private:
   MVRecordAllocator *allocator;
+  MVIndexType indexType;
   uint64_t numSlots;
   MVRecord **tableSlots;
+
+  // Only used by MV_BUCKET_INDEX partitions.
+  uint64_t numBuckets;
+  MVIndexBucket *buckets;
+
+  MVRecord** GetBucketSlot(const CompositeKey &pkey, uint64_t slot, 
+                           bool insert);
+
+  inline uint64_t HashSlot(const CompositeKey &pkey) {
+    if (indexType == MV_BUCKET_INDEX)
+      return CompositeKey::Hash(&pkey) % numBuckets;
+    return CompositeKey::Hash(&pkey) % numSlots;
+  }
         
  public:
 
@@ -23,9 +61,12 @@ class MVTablePartition {
       }
   // Constructor. 
   //
-  // param size: Number of slots in the hash table.
+  // param size: Number of slots in the hash table. A bucketized index is 
+  //             sized to hold twice as many keys.
   // param alloc: Allocator to use for creating MVRecords.
-  MVTablePartition(uint64_t size, int cpu, MVRecordAllocator *alloc);     
+  // param type: Layout of the partition's key index.
+  MVTablePartition(uint64_t size, int cpu, MVRecordAllocator *alloc, 
+                   MVIndexType type = MV_CHAINED_INDEX);     
         
   // Get the latest version for the given primary key. If we're unable to find
   // a live instance of the record, return false. Otherwise, return true.
@@ -49,6 +90,18 @@ class MVTablePartition {
 
   MVRecord* GetMVRecord(const CompositeKey &pkey, uint64_t version);
 
+  // Lookups can be split into stages so that the cache misses of several keys
+  // overlap instead of serializing. GetSlot hashes the key and prefetches its
+  // slot, PrefetchVersion prefetches the key's latest version, and the 
+  // overloads of GetMVRecord and WriteNewVersion that take a slot resolve the 
+  // key without re-hashing it.
+  uint64_t GetSlot(const CompositeKey &pkey);
+  void PrefetchVersion(const CompositeKey &pkey, uint64_t slot);
+  MVRecord* GetMVRecord(const CompositeKey &pkey, uint64_t version, 
+                        uint64_t slot);
+  bool WriteNewVersion(CompositeKey &pkey, mv_action *action, uint64_t version,
+                       uint64_t slot);
+
   
   
   //  void WritePartition();
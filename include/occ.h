@@ -7,6 +7,15 @@
 #include <occ_action.h>
 #include <exception>
 #include <record_buffer.h>
+#include <latency_histogram.h>
+#include <occ_logger.h>
+#include <deque>
+
+/* An epoch deadline which never passes, see OCCWorker::AdvanceEpoch. */
+#define OCC_NO_DEADLINE (~((uint64_t)0))
+
+/* Retry delays stop doubling after this many aborts. */
+#define OCC_BACKOFF_MAX_SHIFT 10
 
 struct OCCActionBatch {
         uint32_t batchSize;
@@ -29,14 +38,33 @@ struct OCCWorkerConfig {
         bool is_leader;
         volatile uint32_t *epoch_ptr;
         volatile uint64_t num_completed;
-        uint64_t epoch_threshold;
+        uint64_t epoch_threshold;               /* In cycles */
         uint64_t log_size;
         bool globalTimestamps;
         uint32_t num_tables;
+        occ_log_channel *log;                   /* NULL if not logging */
+        volatile uint32_t *durable_epoch;
+
+        /* 
+         * rdtsc deadline of the current epoch, shared by all workers. NULL if 
+         * worker 0 advances epochs instead of running txns.
+         */
+        volatile uint64_t *epoch_deadline;
+
+        /* NULL unless reads are validated against write filters. */
+        OCCWriteFilter *write_filter;
+
+        /* NULL unless hot records are locked at first access. */
+        OCCTemperature *temperature;
+
+        /* Base delay before retrying an aborted txn, 0 retries at once. */
+        uint64_t backoff;
 };
 
 
 class OCCWorker : public Runnable {
+        friend class OCCWorkerTest;
+
  private:        
         OCCWorkerConfig config;
         uint64_t incr_timestamp;
@@ -44,10 +72,35 @@ class OCCWorker : public Runnable {
         uint32_t last_epoch;
         uint32_t txn_counter;
         RecordBuffers *bufs;
+
+        /* Cycles from the first attempt of each txn until it commits. */
+        LatencyHistogram latencies;
+
+        /* 
+         * Redo logging. Commits are durable once the logger has synced 
+         * their epoch, until then they're counted in "undurable". 
+         */
+        bool logging;
+        occ_log_buffer log_buf;
+        std::deque<std::pair<uint32_t, uint64_t> > undurable;
+        volatile uint64_t num_durable;
+
+        /* Aborted attempts, counting every retry. */
+        volatile uint64_t num_aborts;
         
         virtual bool RunSingle(OCCAction *action);
+        virtual void LogWrites(OCCAction *action, uint32_t epoch);
+        virtual void PublishEpoch(uint32_t epoch);
+        virtual void AckCommit(uint32_t epoch);
+        virtual void AckDurable();
+        virtual void TxnBoundary();
+        virtual OCCActionBatch NextBatch();
         virtual uint32_t exec_pending(OCCAction **action_list);
         virtual void UpdateEpoch();
+        virtual void AdvanceEpoch();
+        virtual void ScheduleRetry(OCCAction *action,
+                                   const occ_validation_exception &e);
+        virtual bool Deferred(OCCAction *action);
         virtual void EpochManager();
         virtual void TxnRunner();
         
@@ -62,6 +115,13 @@ class OCCWorker : public Runnable {
         
         OCCWorker(OCCWorkerConfig conf, RecordBuffersConfig rb_conf);
         virtual uint64_t NumCompleted();
+        virtual uint64_t NumDurable();
+        virtual uint64_t NumAborts();
+
+        LatencyHistogram* Latencies()
+        {
+                return &latencies;
+        }
 };
 
 #endif		// OCC_H_
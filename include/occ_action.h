@@ -5,6 +5,8 @@
 #include <table.h>
 #include <db.h>
 #include <record_buffer.h>
+#include <occ_write_filter.h>
+#include <occ_temperature.h>
 
 #define TIMESTAMP_MASK (0xFFFFFFFFFFFFFFF0)
 #define EPOCH_MASK (0xFFFFFFFF00000000)
@@ -26,10 +28,19 @@ enum validation_err_t {
 
 class OCCWorker;
 
+/* Carries the record the txn conflicted on. */
 class occ_validation_exception : public std::exception {
  public:
-        occ_validation_exception(validation_err_t err) { this->err = err; }
+        occ_validation_exception(validation_err_t err, uint32_t table_id,
+                                 uint64_t key)
+        {
+                this->err = err;
+                this->table_id = table_id;
+                this->key = key;
+        }
         validation_err_t err;
+        uint32_t table_id;
+        uint64_t key;
 };
 
 
@@ -46,7 +57,7 @@ class occ_composite_key {
         uint64_t key;
         uint64_t old_tid;
         bool is_rmw;
-        bool is_locked;
+        bool is_locked;                 /* Read set: locked as a hot record */
         bool is_initialized;
         void *value;
 
@@ -88,6 +99,7 @@ class occ_composite_key {
 
 class OCCAction : public translator {
         friend class OCCWorker;
+        friend class OCCWorkerTest;
 
  private:
         OCCAction();
@@ -99,6 +111,34 @@ class OCCAction : public translator {
         Table **lock_tables;
         uint64_t tid;
         OCCWorker *worker;
+
+        /* 
+         * Shared write filters, NULL unless large read sets are validated 
+         * against them. start_epoch is the epoch before the first read.
+         */
+        OCCWriteFilter *write_filter;
+        uint32_t start_epoch;
+
+        /* 
+         * Record temperatures, NULL unless hot records are locked when first 
+         * accessed. Such locks are taken in key order, max_hot is the 
+         * largest one held.
+         */
+        OCCTemperature *temperature;
+        uint32_t num_hot;
+        occ_composite_key max_hot;
+
+        /* 
+         * Retry scheduling. Aborts since the last commit, the rdtsc tick 
+         * before which not to retry, and a locked TID to wait out. 
+         */
+        uint32_t num_aborts;
+        uint64_t retry_at;
+        volatile uint64_t *conflict_ptr;
+        uint64_t conflict_tid;
+
+        /* Start of the first attempt since the last commit, 0 if none. */
+        uint64_t start_time;
         std::vector<occ_composite_key> readset;
         std::vector<occ_composite_key> writeset;
         std::vector<occ_composite_key> shadow_writeset;
@@ -108,6 +148,9 @@ class OCCAction : public translator {
         virtual void validate_single(occ_composite_key &comp_key);
         virtual void cleanup_single(occ_composite_key &comp_key);
         virtual void install_single_write(occ_composite_key &comp_key);
+        virtual bool lock_hot(occ_composite_key &comp_key);
+        virtual uint64_t locked_copy(occ_composite_key &comp_key,
+                                     void *record);
         
  public:
         
@@ -123,7 +166,8 @@ class OCCAction : public translator {
 
         virtual bool run();
         virtual void acquire_locks();
-        virtual void validate();
+        virtual void publish_writes(uint32_t epoch);
+        virtual void validate(uint32_t epoch);
         virtual uint64_t compute_tid(uint32_t epoch, uint64_t last_tid);
         virtual void install_writes();
         virtual void release_locks();
@@ -0,0 +1,76 @@
+#ifndef         OCC_CHECKPOINT_H_
+#define         OCC_CHECKPOINT_H_
+
+#include <runnable.hh>
+#include <table.h>
+#include <cpuinfo.h>
+
+#define OCC_CKPT_MAGIC 0x4f4343434b505431ULL
+#define OCC_CKPT_MAX_TABLES 2
+
+/* Bucket ranges in an image, a loader thread restores whole partitions. */
+#define OCC_CKPT_PARTITIONS 64
+
+/*
+ * Image layout: an occ_ckpt_header, then the records of each partition of
+ * each table, contiguously. A record is its key followed by the value, which
+ * starts with the record's TID.
+ */
+struct occ_ckpt_table {
+        uint64_t num_buckets;
+        uint64_t value_sz;
+        uint64_t offsets[OCC_CKPT_PARTITIONS];
+        uint64_t counts[OCC_CKPT_PARTITIONS];
+};
+
+struct occ_ckpt_header {
+        uint64_t magic;
+        uint32_t num_tables;
+        uint32_t begin_epoch;
+        uint32_t end_epoch;
+        occ_ckpt_table tables[OCC_CKPT_MAX_TABLES];
+};
+
+struct OCCCheckpointerConfig {
+        int cpu;
+        const char *path;
+        Table **tables;
+        uint32_t num_tables;
+        volatile uint32_t *epoch_ptr;
+};
+
+/*
+ * Writes a single fuzzy image of the tables while txns keep running. Every
+ * record is copied stably and carries its TID, and the header carries the
+ * epochs in which the checkpoint began and ended. Records in the image are
+ * consistent as of the begin epoch, together with the redo log from then on.
+ */
+class OCCCheckpointer : public Runnable {
+ private:
+        OCCCheckpointerConfig config;
+
+        uint64_t WriteRecord(FILE *file, Table *table, TableRecord *rec,
+                             char *buf);
+
+ protected:
+        virtual void StartWorking();
+        virtual void Init();
+
+ public:
+        void* operator new(std::size_t sz, int cpu)
+        {
+                return alloc_mem(sz, cpu);
+        }
+
+        OCCCheckpointer(OCCCheckpointerConfig config);
+};
+
+/*
+ * Rebuild tables from an image, with one thread per range of partitions. The
+ * tables must be empty and sized like the ones the image was taken from.
+ * Returns the image's begin epoch.
+ */
+uint32_t occ_load_checkpoint(const char *path, Table **tables,
+                             uint32_t num_tables, uint32_t num_threads);
+
+#endif          // OCC_CHECKPOINT_H_
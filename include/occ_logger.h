@@ -0,0 +1,73 @@
+#ifndef         OCC_LOGGER_H_
+#define         OCC_LOGGER_H_
+
+#include <runnable.hh>
+#include <concurrent_queue.h>
+#include <cpuinfo.h>
+#include <machine.h>
+
+/* Log buffers per worker, they split OCCWorkerConfig::log_size. */
+#define OCC_LOG_BUFFERS 8
+
+/*
+ * Redo log entries of txns which committed in a single epoch. Every entry is
+ * an occ_log_header followed by record_len bytes of the new value.
+ */
+struct occ_log_buffer {
+        char *data;
+        uint64_t size;
+        uint64_t capacity;
+        uint32_t epoch;
+};
+
+/*
+ * Shared by a worker and the logger. The worker hands filled buffers over
+ * through "full", and gets them back through "free" once they're written.
+ * "epoch" is the epoch of the buffer the worker is filling, all of its
+ * buffers from earlier epochs were enqueued before it advanced.
+ */
+struct occ_log_channel {
+        SimpleQueue<occ_log_buffer> *full;
+        SimpleQueue<occ_log_buffer> *free;
+        volatile uint32_t __attribute__((__aligned__(CACHE_LINE))) epoch;
+};
+
+struct OCCLoggerConfig {
+        int cpu;
+        int fd;
+        occ_log_channel **channels;
+        uint32_t num_channels;
+        volatile uint32_t *durable_epoch;
+};
+
+/*
+ * Silo-style group commit. The logger writes every buffer it gets, and once
+ * all workers have moved past an epoch, syncs the file and publishes the
+ * epoch as durable. Workers acknowledge commits at that granularity.
+ */
+class OCCLogger : public Runnable {
+ private:
+        OCCLoggerConfig config;
+        uint32_t durable;
+        bool dirty;
+
+        bool Drain();
+        uint32_t MinEpoch();
+
+ protected:
+        virtual void StartWorking();
+        virtual void Init();
+
+ public:
+        void* operator new(std::size_t sz, int cpu)
+        {
+                return alloc_mem(sz, cpu);
+        }
+
+        OCCLogger(OCCLoggerConfig config);
+        bool Sync();
+
+        static occ_log_channel* CreateChannel(uint64_t log_size, int cpu);
+};
+
+#endif          // OCC_LOGGER_H_
@@ -0,0 +1,139 @@
+#ifndef         OCC_TABLE_H_
+#define         OCC_TABLE_H_
+
+#include <table.h>
+#include <machine.h>
+
+#define OCC_TABLE_EMPTY_KEY (~((uint64_t)0))
+
+/*
+ * A slot holds the key followed by the record, whose first word is the TID
+ * (and lock). Slots no larger than a cache line are sized to a power of two
+ * and never straddle a line, larger ones start on a line boundary.
+ */
+struct OCCTableSlot {
+        volatile uint64_t key;
+        char value[0];
+};
+
+/*
+ * Open-addressed table for OCC records. Records live inline in a linearly
+ * probed array, so looking a key up touches the line which also holds its TID
+ * and the start of its value, instead of a bucket array and then a chain.
+ *
+ * Get() returns the same pointer Table::Get() does, the start of the record.
+ * Inserts are only safe before SetInit(), from a single thread. The chained
+ * bucket interface (GetBucket, TakeFreeRecords, InsertRecord) isn't
+ * supported.
+ */
+class OCCTable : public Table {
+ private:
+        char *slots;
+        uint64_t num_slots;
+        uint64_t slot_sz;
+        uint64_t free_slots;
+
+        inline OCCTableSlot* GetSlot(uint64_t index)
+        {
+                return (OCCTableSlot*)&slots[index*slot_sz];
+        }
+
+        inline uint64_t HomeIndex(uint64_t key)
+        {
+                return Hash128to64(std::make_pair(conf.tableId, key)) &
+                        (num_slots - 1);
+        }
+
+        /* The slot which holds key, or the empty slot where it belongs. */
+        inline OCCTableSlot* Probe(uint64_t key)
+        {
+                OCCTableSlot *slot;
+                uint64_t index;
+
+                assert(key != OCC_TABLE_EMPTY_KEY);
+                index = HomeIndex(key);
+                while (true) {
+                        slot = GetSlot(index);
+                        if (slot->key == key ||
+                            slot->key == OCC_TABLE_EMPTY_KEY)
+                                return slot;
+                        index = (index + 1) & (num_slots - 1);
+                }
+        }
+
+        inline OCCTableSlot* Insert(uint64_t key)
+        {
+                OCCTableSlot *slot;
+
+                assert(this->init == false);
+                slot = Probe(key);
+                if (slot->key == OCC_TABLE_EMPTY_KEY) {
+                        assert(free_slots > 0);
+                        free_slots -= 1;
+                        slot->key = key;
+                }
+                return slot;
+        }
+
+ public:
+        void* operator new(std::size_t sz, int cpu)
+        {
+                return alloc_mem(sz, cpu);
+        }
+
+        /*
+         * conf.freeListSz bounds the number of keys, the array is kept at
+         * most half full.
+         */
+        OCCTable(TableConfig conf)
+        {
+                uint64_t i, record_sz;
+
+                this->conf = conf;
+                free_slots = conf.freeListSz;
+                record_sz = sizeof(OCCTableSlot) + conf.valueSz;
+                if (record_sz <= CACHE_LINE) {
+                        for (slot_sz = 8; slot_sz < record_sz; slot_sz <<= 1)
+                                ;
+                } else {
+                        slot_sz = (record_sz + CACHE_LINE - 1) &
+                                ~((uint64_t)CACHE_LINE - 1);
+                }
+                for (num_slots = 1; num_slots < 2*conf.freeListSz;
+                     num_slots <<= 1)
+                        ;
+                slots = (char*)alloc_interleaved_all(num_slots*slot_sz);
+                assert(((uint64_t)slots & (CACHE_LINE - 1)) == 0);
+                memset(slots, 0x0, num_slots*slot_sz);
+                for (i = 0; i < num_slots; ++i)
+                        GetSlot(i)->key = OCC_TABLE_EMPTY_KEY;
+        }
+
+        virtual void PutEmpty(uint64_t key)
+        {
+                Insert(key);
+        }
+
+        virtual void Put(uint64_t key, void *value)
+        {
+                memcpy(Insert(key)->value, value, conf.valueSz);
+        }
+
+        virtual void* Get(uint64_t key)
+        {
+                OCCTableSlot *slot;
+
+                slot = Probe(key);
+                assert(slot->key == key);
+                return (void*)slot->value;
+        }
+
+        virtual void* GetAlways(uint64_t key)
+        {
+                if (this->init == true)
+                        return Get(key);
+                return (void*)Insert(key)->value;
+        }
+};
+
+#endif          // OCC_TABLE_H_
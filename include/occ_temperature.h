@@ -0,0 +1,35 @@
+#ifndef         OCC_TEMPERATURE_H_
+#define         OCC_TEMPERATURE_H_
+
+#include <stdint.h>
+#include <cstddef>
+
+/* Counters in the table, records which hash to the same one share it. */
+#define OCC_TEMP_LOG_SIZE 18
+
+/* A counter which hasn't been heated for this many epochs starts over. */
+#define OCC_TEMP_WINDOW 4
+
+/*
+ * MOCC-style record temperatures. Every abort heats the record it conflicted
+ * on, and records heated threshold times within a few epochs count as hot.
+ * Each counter holds the epoch it was last heated in and its count. Updates
+ * aren't atomic, a lost increment only delays a record getting hot.
+ */
+class OCCTemperature {
+ private:
+        volatile uint64_t *counters;
+        uint32_t threshold;
+
+        static uint64_t Index(uint32_t table_id, uint64_t key);
+
+ public:
+        void* operator new(std::size_t sz, int cpu);
+
+        OCCTemperature(uint32_t threshold);
+
+        void Heat(uint32_t epoch, uint32_t table_id, uint64_t key);
+        bool IsHot(uint32_t epoch, uint32_t table_id, uint64_t key);
+};
+
+#endif          // OCC_TEMPERATURE_H_
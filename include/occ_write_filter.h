@@ -0,0 +1,63 @@
+#ifndef         OCC_WRITE_FILTER_H_
+#define         OCC_WRITE_FILTER_H_
+
+#include <stdint.h>
+#include <cstddef>
+
+/* Epochs whose filters are kept, a power of two. */
+#define OCC_FILTER_EPOCHS 8
+
+/* Read sets smaller than this are validated key by key. */
+#define OCC_FILTER_MIN_READS 64
+
+#define OCC_FILTER_INVALID_EPOCH (~((uint32_t)0))
+
+struct occ_epoch_filter {
+        volatile uint32_t epoch;
+        volatile uint64_t *bits;
+};
+
+/*
+ * Bloom filters over the keys written in each of the last few epochs. Writers
+ * add their write set to the filter of their commit epoch before they
+ * validate. A reader which started in epoch "first" then only has to
+ * re-validate the keys which may have been written in [first, last].
+ *
+ * The filter of an epoch is cleared by whoever advances the epoch two epochs
+ * before it, and carries its epoch number while it's valid. A filter whose
+ * number doesn't match has been recycled, and callers fall back to full
+ * validation.
+ */
+class OCCWriteFilter {
+ private:
+        occ_epoch_filter filters[OCC_FILTER_EPOCHS];
+        uint64_t num_bits;
+
+        inline occ_epoch_filter* GetFilter(uint32_t epoch)
+        {
+                return &filters[epoch & (OCC_FILTER_EPOCHS - 1)];
+        }
+
+        static uint64_t Hash(uint32_t table_id, uint64_t key);
+
+ public:
+        void* operator new(std::size_t sz, int cpu);
+
+        OCCWriteFilter(uint32_t log_bits);
+
+        /*
+         * Clear the filter for an epoch which hasn't started. Must not race
+         * with Prepare() for another epoch.
+         */
+        void Prepare(uint32_t epoch);
+
+        void Insert(uint32_t epoch, uint32_t table_id, uint64_t key);
+
+        /* True if the filters of all epochs in [first, last] are valid. */
+        bool Covers(uint32_t first, uint32_t last);
+
+        bool MayContain(uint32_t first, uint32_t last, uint32_t table_id,
+                        uint64_t key);
+};
+
+#endif          // OCC_WRITE_FILTER_H_
@@ -10,6 +10,13 @@
 
 extern uint64_t recordSize;
 
+/* 
+ * Every MV_CHAIN_SAMPLE'th new version, a scheduler records the length of the 
+ * version's chain. Bucket b of the histogram counts lengths in [2^b, 2^(b+1)).
+ */
+#define MV_CHAIN_SAMPLE 64
+#define MV_CHAIN_BUCKETS 16
+
 class CompositeKey;
 class mv_action;
 class MVRecordAllocator;
@@ -21,7 +28,8 @@ class MVTablePartition;
  * Its job is to take a batch of transactions as input, and assign each key of 
  * each transaction to a concurrency control worker thread. We hash keys in this
  * stage because it reduces the amount of serial work that must be perfomed by 
- * the concurrency control stage.
+ * the concurrency control stage. Each concurrency control thread is handed 
+ * the list of keys it owns, so it never scans actions it has no keys in.
  */
 class MVActionHasher : public Runnable {
  private:
@@ -47,8 +55,10 @@ class MVActionHasher : public Runnable {
   
   virtual void Init();
   
-  static inline void ProcessAction(mv_action *action, uint32_t epoch, 
-                                   uint32_t txnCounter);
+  // Sort the keys of a batch by concurrency control thread. Keys appear in 
+  // timestamp order within each thread's list, and an action's reads precede
+  // its writes.
+  static MVKeyRefList* SortKeys(const ActionBatch &batch);
 
  public:
   
@@ -87,6 +97,12 @@ struct MVSchedulerConfig {
 
         int worker_start;
         int worker_end;
+
+        MVIndexType indexType;        // Layout of each table partition's index
+        int recordCpu;                // Home of record data, -1 to interleave
+
+        // Epochs up to *lowWaterMarkPtr have been executed. NULL if unknown.
+        volatile uint32_t *lowWaterMarkPtr;
         
   /*
   // Coordination queues required by the leader thread.
@@ -107,6 +123,7 @@ struct MVSchedulerConfig {
  */
 class MVScheduler : public Runnable {
         friend class SchedulerTest;
+        friend class MVSchedulerTest;
         
  private:
         static inline uint32_t GetCCThread(CompositeKey key);
@@ -122,10 +139,25 @@ class MVScheduler : public Runnable {
 
     uint32_t threadId;
 
+    /* Cycles spent scheduling batches, excluding time spent waiting for input. */
+    volatile uint64_t busyCycles;
+
+    /* 
+     * Low watermark as of the last batch or recycling pass, versions below 
+     * which are trimmed from chains, and the histogram of sampled chain 
+     * lengths.
+     */
+    uint32_t lowWatermark;
+    uint64_t numVersions;
+    uint64_t chainLengths[MV_CHAIN_BUCKETS];
+
  protected:
         virtual void StartWorking();
         void ProcessWriteset(mv_action *action);
         void ScheduleTransaction(mv_action *action);
+        void ScheduleKeys(const ActionBatch &batch);
+        void TrimChain(MVRecord *version);
+        void ReadLowWatermark();
         //    void Leader(uint32_t epoch);
         //    void Subordinate(uint32_t epoch);
     virtual void Init();
@@ -154,6 +186,20 @@ class MVScheduler : public Runnable {
 
         static uint32_t NUM_CC_THREADS;
         MVScheduler(MVSchedulerConfig config);
+
+        uint64_t BusyCycles() {
+                return busyCycles;
+        }
+
+        uint64_t ChainLengths(uint32_t bucket) {
+                assert(bucket < MV_CHAIN_BUCKETS);
+                return chainLengths[bucket];
+        }
+
+        MVTablePartition* GetPartition(uint32_t table) {
+                assert(table < config.numTables);
+                return partitions[table];
+        }
 };
 
 
@@ -22,7 +22,7 @@ struct TableConfig {
 };
 
 class Table {
- private:
+ protected:
   TableRecord **buckets;
   TableRecord *freeList;
   TableConfig  conf;
@@ -37,6 +37,14 @@ class Table {
     return ret;
   }
 
+  // For subclasses which keep records in a layout of their own.
+  Table() {
+    this->init = false;
+    this->buckets = NULL;
+    this->freeList = NULL;
+    this->default_value = NULL;
+  }
+
  public:
   void* operator new(std::size_t sz, int cpu) {
           return alloc_mem(sz, cpu);
@@ -126,6 +134,52 @@ class Table {
   {
           return conf.valueSz;
   }
+
+  uint64_t NumBuckets()
+  {
+          return conf.numBuckets;
+  }
+
+  uint64_t BucketIndex(uint64_t key)
+  {
+          return Hash128to64(std::make_pair(conf.tableId, key)) % conf.numBuckets;
+  }
+
+  // Records in a bucket, chained through TableRecord::next.
+  TableRecord* GetBucket(uint64_t index)
+  {
+          assert(index < conf.numBuckets);
+          return buckets[index];
+  }
+
+  // Detach a chain of n records from the free list, for a bulk loader.
+  TableRecord* TakeFreeRecords(uint64_t n)
+  {
+          TableRecord *ret, *last;
+          uint64_t i;
+
+          if (n == 0)
+                  return NULL;
+          ret = freeList;
+          last = freeList;
+          for (i = 1; i < n; ++i) {
+                  assert(last != NULL);
+                  last = last->next;
+          }
+          assert(last != NULL);
+          freeList = last->next;
+          last->next = NULL;
+          return ret;
+  }
+
+  // Link a filled-in record into its bucket. Concurrent callers must insert 
+  // into disjoint buckets.
+  void InsertRecord(TableRecord *rec)
+  {
+          uint64_t index = BucketIndex(rec->key);
+          rec->next = buckets[index];
+          buckets[index] = rec;
+  }
 };
 
 #endif          // TABLE_H_
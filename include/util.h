@@ -95,6 +95,42 @@ unlock(volatile uint64_t *word) {
   xchgq(word, 0);
 }
 
+// MCS queue lock. The lock word holds a pointer to the last waiter's node, or 0
+// if the lock is free. Each waiter spins on its own node instead of the word.
+struct mcs_node {
+  volatile uint64_t next;
+  volatile uint64_t locked;
+};
+
+inline void
+mcs_lock(volatile uint64_t *word, struct mcs_node *me) {
+  uint64_t prev;
+
+  me->next = 0;
+  me->locked = 1;
+  barrier();
+  prev = xchgq(word, (uint64_t)me);
+  if (prev != 0) {
+    ((struct mcs_node*)prev)->next = (uint64_t)me;
+    while (me->locked != 0)
+      do_pause();
+  }
+  barrier();
+}
+
+inline void
+mcs_unlock(volatile uint64_t *word, struct mcs_node *me) {
+  barrier();
+  if (me->next == 0) {
+    if (cmp_and_swap(word, (uint64_t)me, 0))
+      return;
+    // A waiter swapped itself in, but hasn't linked its node yet.
+    while (me->next == 0)
+      do_pause();
+  }
+  ((struct mcs_node*)me->next)->locked = 0;
+}
+
 inline uint32_t
 fetch_and_increment_32(volatile uint32_t *variable)
 {
@@ -128,6 +164,15 @@ fetch_and_decrement(volatile uint64_t *variable)
   return counter_value - 1;
 }    
 
+inline void
+atomic_or(volatile uint64_t *word, uint64_t bits)
+{
+  asm volatile ("lock; orq %1, %0;"
+                : "+m" (*word)
+                : "r" (bits)
+                : "memory");
+}
+
 
 
 // Use this function to read the timestamp counter. 
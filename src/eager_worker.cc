@@ -9,6 +9,7 @@ locking_worker::locking_worker(locking_worker_config config,
         m_queue_tail = NULL;    
         m_num_elems = 0;
         m_num_done = 0;
+        m_num_aborts = 0;
         this->bufs = new(config.cpu) RecordBuffers(rb_conf);
 }
 
@@ -88,14 +89,32 @@ void locking_worker::CheckReady()
 
 void locking_worker::exec(locking_action *txn)
 {
-        /* Acquire locks dynamically while running the txn */
+        uint64_t start;
+
+        /* 
+         * Acquire locks dynamically while running the txn. If the lock policy 
+         * aborts it, drop its writes and locks, and run it again.
+         */
+        start = rdtsc();
         txn->tables = this->config.tables;
         txn->mgr = config.mgr;
         txn->worker = this;
         txn->bufs = this->bufs;
-        txn->Run();
+        config.mgr->Begin(txn);
+        while (true) {
+                try {
+                        txn->Run();
+                        break;
+                } catch (const locking_abort_exception &e) {
+                        txn->commit_writes(false);
+                        config.mgr->Unlock(txn);
+                        txn->num_acquired = 0;
+                        m_num_aborts += 1;
+                }
+        }
         config.mgr->Unlock(txn);
         assert(txn->finished_execution);
+        latencies.Record(rdtsc() - start);
 }
 
 void locking_worker::TryExec(locking_action *txn)
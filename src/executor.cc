@@ -2,6 +2,12 @@
 #include <common_constants.h>
 #include <algorithm>
 
+/* 
+ * Bound on the number of blocked actions a work stealing executor parks before
+ * it stops taking new work and waits for them to become runnable.
+ */
+#define STEAL_MAX_PENDING 64
+
 PendingActionList::PendingActionList(uint32_t freeListSize) 
 {
         freeList = (ActionListNode*)malloc(sizeof(ActionListNode)*freeListSize);
@@ -109,6 +115,11 @@ Executor::Executor(ExecutorConfig cfg) : Runnable (cfg.cpu)
 {        
         this->config = cfg;
         this->counter = 0;
+        this->numWaiting = 0;
+        this->readyList = 0;
+        this->idleCycles = 0;
+        this->localAccesses = 0;
+        this->remoteAccesses = 0;
         this->pendingList = new (config.cpu) PendingActionList(1000);
         this->garbageBin = new (config.cpu) GarbageBin(config.garbageConfig);
 }
@@ -145,18 +156,22 @@ void Executor::StartWorking()
 {
         uint32_t epoch = 1;
         ActionBatch batch;
+        uint64_t start;
 
         while (true) {
 
+                start = rdtsc();
                 if (config.threadId == 0) {
                         while (!config.inputQueue->Dequeue(&batch)) {
                                 adjust_lowwatermark();
                         }
-                        ProcessBatch(batch);
                 } else {
                         batch = config.inputQueue->DequeueBlocking();
-                        ProcessBatch(batch);    
                 }
+                barrier();
+                idleCycles += rdtsc() - start;
+                barrier();
+                ProcessBatch(batch);
 
                 barrier();
                 *config.epochPtr = epoch;
@@ -191,40 +206,302 @@ void Executor::RecycleData()
         }
 }
 
+/* 
+ * Park action on blocker, the action it's waiting for. Returns false if 
+ * blocker has already been substantiated. 
+ */
+bool Executor::AddWaiter(mv_action *blocker, mv_action *action)
+{
+        uint64_t head;
+
+        action->parked_on = this;
+        while (true) {
+                barrier();
+                head = blocker->waiters;
+                barrier();
+                if (head == MV_WAITERS_CLOSED)
+                        return false;
+                action->next_waiter = (mv_action*)head;
+                if (cmp_and_swap(&blocker->waiters, head, (uint64_t)action))
+                        return true;
+        }
+}
+
+/* Hand a previously blocked action back to this executor. */
+void Executor::PushReady(mv_action *action)
+{
+        uint64_t head;
+        while (true) {
+                barrier();
+                head = readyList;
+                barrier();
+                action->next_waiter = (mv_action*)head;
+                if (cmp_and_swap(&readyList, head, (uint64_t)action))
+                        return;
+        }
+}
+
+/* 
+ * Called once action is substantiated. Close its list of waiters, and return 
+ * each waiter to the executor that parked it. 
+ */
+void Executor::WakeWaiters(mv_action *action)
+{
+        mv_action *waiter, *next;
+
+        waiter = (mv_action*)xchgq(&action->waiters, MV_WAITERS_CLOSED);
+        assert(waiter != (mv_action*)MV_WAITERS_CLOSED);
+        while (waiter != NULL) {
+                next = waiter->next_waiter;
+                waiter->parked_on->PushReady(waiter);
+                waiter = next;
+        }
+}
+
+/* 
+ * Park an action which could not run. If we know which action it's blocked on,
+ * wait for that action to wake it up, otherwise poll it on the pending list.
+ */
+void Executor::ParkAction(mv_action *action, mv_action *blocker)
+{
+        if (blocker != NULL && AddWaiter(blocker, action)) 
+                numWaiting += 1;
+        else 
+                pendingList->EnqueuePending(action);
+}
+
+inline uint32_t Executor::NumPending()
+{
+        return numWaiting + pendingList->Size();
+}
+
 void Executor::ExecPending() 
 {
+        mv_action *ready, *next, *blocker;
+
+        /* Retry the actions whose blockers have been substantiated. */
+        barrier();
+        if (readyList != 0) {
+                ready = (mv_action*)xchgq(&readyList, 0);
+                while (ready != NULL) {
+                        next = ready->next_waiter;
+                        numWaiting -= 1;
+                        if (!ProcessSingle(ready, &blocker)) 
+                                ParkAction(ready, blocker);
+                        ready = next;
+                }
+        }
+
+        /* Poll the actions which couldn't be parked on a blocker. */
         pendingList->ResetCursor();
         for (ActionListNode *node = pendingList->GetNext(); node != NULL; 
              node = pendingList->GetNext()) {
-                if (ProcessSingle(node->action)) {
+                if (ProcessSingle(node->action, &blocker)) {
                         pendingList->DequeuePending(node);
+                } else if (blocker != NULL && 
+                           AddWaiter(blocker, node->action)) {
+                        pendingList->DequeuePending(node);
+                        numWaiting += 1;
                 }
         }
 }
 
+/* 
+ * The first action of the batch owned by this thread. Unless the batch is 
+ * routed, actions are striped across all executors. rank tracks how many 
+ * actions routed to this thread's node have been seen.
+ */
+uint32_t Executor::FirstAction(const ActionBatch &batch, uint32_t *rank)
+{
+        *rank = 0;
+        if (batch.homeNodes == NULL) 
+                return config.threadId;
+        return FindRouted(batch, 0, rank);
+}
+
+/* The next action of the batch owned by this thread after action i. */
+uint32_t Executor::NextAction(const ActionBatch &batch, uint32_t i, 
+                              uint32_t *rank)
+{
+        if (batch.homeNodes == NULL) 
+                return i + config.numExecutors;
+        return FindRouted(batch, i+1, rank);
+}
+
+/* 
+ * Find the first action from i onwards which is routed to this thread's node,
+ * and falls in this thread's stripe of the node's actions.
+ */
+uint32_t Executor::FindRouted(const ActionBatch &batch, uint32_t i, 
+                              uint32_t *rank)
+{
+        for (; i < batch.numActions; ++i) {
+                if (batch.homeNodes[i] != config.node)
+                        continue;
+                *rank += 1;
+                if (*rank % config.nodeExecutors == config.nodeRank)
+                        return i;
+        }
+        return batch.numActions;
+}
+
+/* Count the action's record accesses by whether they stay on this node. */
+void Executor::CountAccesses(mv_action *action)
+{
+        uint32_t i, num_reads, num_writes;
+
+        num_reads = action->__readset.size();
+        num_writes = action->__writeset.size();
+        for (i = 0; i < num_reads; ++i) {
+                if (config.partitionNodes[action->__readset[i].threadId] == 
+                    config.node)
+                        localAccesses += 1;
+                else
+                        remoteAccesses += 1;
+        }
+        for (i = 0; i < num_writes; ++i) {
+                if (config.partitionNodes[action->__writeset[i].threadId] == 
+                    config.node)
+                        localAccesses += 1;
+                else
+                        remoteAccesses += 1;
+        }
+}
+
 /* Process a single batch of transactions. */
 void Executor::ProcessBatch(const ActionBatch &batch) 
 {
-        for (int i = config.threadId; i < (int)batch.numActions;
-             i += config.numExecutors) {
-                while (pendingList->Size() > 0) {
+        if (config.deques != NULL) {
+                ProcessBatchStealing(batch);
+                return;
+        }
+
+        mv_action *blocker;
+        uint32_t i, rank;
+        for (i = FirstAction(batch, &rank); i < batch.numActions;
+             i = NextAction(batch, i, &rank)) {
+                while (NumPending() > 0) {
                         ExecPending();
                 }
 
                 mv_action *cur = batch.actionBuf[i];
-                if (!ProcessSingle(cur)) {
-                        pendingList->EnqueuePending(cur);
+                if (!ProcessSingle(cur, &blocker)) {
+                        ParkAction(cur, blocker);
                 }
         }
+        ProcessSnapshots(batch);
 
-        while (!pendingList->IsEmpty()) {
+        while (NumPending() > 0) {
                 ExecPending();
         }
 
-        ActionBatch dummy = {NULL, 0};
+        ActionBatch dummy = {NULL, 0, NULL, NULL, NULL, 0, 0};
         config.outputQueue->EnqueueBlocking(dummy);  
 }
 
+/* 
+ * Take an action of the batch with the given epoch from a peer which is 
+ * running the same batch. Peers are tried round-robin, starting with the next 
+ * thread.
+ */
+bool Executor::StealAction(mv_action **action, uint32_t epoch)
+{
+        volatile uint32_t *epochs;
+        uint32_t i, peer;
+        uint64_t batch_epoch;
+
+        /* 
+         * epochPtr points into an array of every executor's last completed 
+         * epoch, so a peer running the batch has completed the one before it.
+         */
+        epochs = config.epochPtr - config.threadId;
+        batch_epoch = CREATE_MV_TIMESTAMP(epoch, 0);
+        for (i = 1; i < config.numExecutors; ++i) {
+                peer = (config.threadId + i) % config.numExecutors;
+                barrier();
+                if (epochs[peer] + 1 != epoch)
+                        continue;
+                barrier();
+
+                /* 
+                 * The peer may move on to the next batch between the check 
+                 * above and the steal, so check the action itself too. 
+                 */
+                if (config.deques[peer]->StealIf(action, 
+                                                 [batch_epoch](mv_action *a) {
+                        return GET_MV_EPOCH(a->__version) == batch_epoch;
+                    }))
+                        return true;
+        }
+        return false;
+}
+
+/* 
+ * Process a single batch of transactions in work stealing mode. The thread's
+ * share of the batch is published in its deque. Blocked actions are parked on 
+ * the pending list, and instead of spinning on them the thread keeps running 
+ * its own actions, or steals actions from peers once its deque is empty.
+ */
+void Executor::ProcessBatchStealing(const ActionBatch &batch)
+{
+        WorkStealingDeque<mv_action*> *deque;
+        mv_action *cur, *blocker;
+        uint32_t i, rank, epoch;
+
+        /* The batch's epoch, one past the last epoch this thread completed. */
+        epoch = *config.epochPtr + 1;
+        deque = config.deques[config.threadId];
+        for (i = FirstAction(batch, &rank); i < batch.numActions; 
+             i = NextAction(batch, i, &rank)) {
+                cur = batch.actionBuf[i];
+                if (deque->Push(cur))
+                        continue;
+
+                /* The deque is full, run the action right away. */
+                while (NumPending() > 0) 
+                        ExecPending();
+                if (!ProcessSingle(cur, &blocker))
+                        ParkAction(cur, blocker);
+        }
+        ProcessSnapshots(batch);
+
+        while (true) {
+                if (NumPending() > 0)
+                        ExecPending();
+                if (NumPending() >= STEAL_MAX_PENDING)
+                        continue;
+                if (deque->Pop(&cur) || StealAction(&cur, epoch)) {
+                        if (!ProcessSingle(cur, &blocker))
+                                ParkAction(cur, blocker);
+                } else if (NumPending() == 0) {
+                        break;
+                }
+        }
+
+        ActionBatch dummy = {NULL, 0, NULL, NULL, NULL, 0, 0};
+        config.outputQueue->EnqueueBlocking(dummy);  
+}
+
+/* 
+ * Run this thread's share of the batch's snapshot reads. They are not pushed 
+ * to the work stealing deques, because they must run before this thread 
+ * finishes the batch (see run_snapshot).
+ */
+void Executor::ProcessSnapshots(const ActionBatch &batch)
+{
+        mv_action *cur, *blocker;
+        uint32_t i;
+
+        for (i = config.threadId; i < batch.numReadOnly; 
+             i += config.numExecutors) {
+                while (NumPending() > 0)
+                        ExecPending();
+                cur = batch.readOnlyBuf[i];
+                if (!ProcessSingle(cur, &blocker))
+                        ParkAction(cur, blocker);
+        }
+}
+
 // Returns the epoch of the oldest pending record.
 uint32_t Executor::DoPendingGC() 
 {
@@ -272,7 +549,7 @@ bool Executor::ProcessSingleGC(mv_action *action)
                                 // Since the previous txn has been substantiated, the record's value 
                                 // shouldn't be NULL.
                                 assert(previous->value != NULL);
-                                garbageBin->AddRecord(previous->writingThread, 
+                                garbageBin->AddRecord(config.threadId, 
                                                       action->__writeset[i].tableId,
                                                       previous->value);
                                 //        garbageBin->AddMVRecord(action->__writeset[i].threadId, previous);
@@ -283,18 +560,24 @@ bool Executor::ProcessSingleGC(mv_action *action)
         return ret;
 }
 
-/* Take ownership of a transaction's execution. */
-bool Executor::ProcessSingle(mv_action *action) 
+/* 
+ * Take ownership of a transaction's execution. If the transaction is blocked 
+ * on a conflicting predecessor, the predecessor is returned through blocker.
+ */
+bool Executor::ProcessSingle(mv_action *action, mv_action **blocker) 
 {
         assert(action != NULL);
         volatile uint64_t state;
+        if (blocker != NULL)
+                *blocker = NULL;
         barrier();
         state = action->__state;
         barrier();
         if (state != SUBSTANTIATED) {
                 if (state == STICKY &&
                     cmp_and_swap(&action->__state, STICKY, PROCESSING)) {
-                        if (ProcessTxn(action)) {
+                        if (ProcessTxn(action, blocker)) {
+                                latencies.Record(rdtsc() - action->start_time);
                                 return true;
                         } else {
                                 xchgq(&action->__state, STICKY);
@@ -313,7 +596,7 @@ bool Executor::ProcessSingle(mv_action *action)
  * Check whether all of a transaction's conflicting ancestors have finished 
  * executing.
  */
-bool Executor::check_ready(mv_action *action)
+bool Executor::check_ready(mv_action *action, mv_action **blocker)
 {
         uint32_t num_reads, num_writes, i;
         bool ready;
@@ -335,6 +618,8 @@ bool Executor::check_ready(mv_action *action)
                 if (depend_action != NULL &&
                     depend_action->__state != SUBSTANTIATED &&
                     !ProcessSingle(depend_action)) {
+                        if (blocker != NULL)
+                                *blocker = depend_action;
                         ready = false;
                         break;
                 }
@@ -349,6 +634,8 @@ bool Executor::check_ready(mv_action *action)
                         if (depend_action != NULL &&
                             depend_action->__state != SUBSTANTIATED && 
                             !ProcessSingle(depend_action)) {
+                                if (blocker != NULL)
+                                        *blocker = depend_action;
                                 ready = false;
                                 break;
                         } else if (action->__writeset[i].initialized == false) {
@@ -401,30 +688,126 @@ bool Executor::run_readonly(mv_action *action)
         action->exec = this;
         action->Run();
         xchgq(&action->__state, SUBSTANTIATED);
+        WakeWaiters(action);
+        if (config.partitionNodes != NULL)
+                CountAccesses(action);
         return true;
         
 }
 
+/*
+ * Resolve a snapshot read's keys which are yet to be looked up, in groups of 
+ * MV_LOOKUP_BATCH. As in MVScheduler::ProcessWriteset, every key of a group 
+ * is hashed and its slot prefetched before any key is resolved, so that the 
+ * misses of the transaction's keys overlap instead of serializing.
+ */
+static void snapshot_lookup(MVTable **tables, mv_action *action, 
+                            uint64_t version)
+{
+        CompositeKey *keys[MV_LOOKUP_BATCH];
+        MVTablePartition *parts[MV_LOOKUP_BATCH];
+        uint64_t slots[MV_LOOKUP_BATCH];
+        uint32_t i, j, n, num_reads;
+
+        num_reads = action->__readset.size();
+        i = 0;
+        while (i < num_reads) {
+                n = 0;
+                for (; i < num_reads && n < MV_LOOKUP_BATCH; ++i) {
+                        if (action->__readset[i].value != NULL)
+                                continue;
+                        keys[n] = &action->__readset[i];
+                        parts[n] = tables[keys[n]->tableId]->
+                                GetPartition(keys[n]->threadId);
+                        slots[n] = parts[n]->GetSlot(*keys[n]);
+                        n += 1;
+                }
+                for (j = 0; j < n; ++j) 
+                        parts[j]->PrefetchVersion(*keys[j], slots[j]);
+                for (j = 0; j < n; ++j) 
+                        keys[j]->value = parts[j]->GetMVRecord(*keys[j], 
+                                                               version, 
+                                                               slots[j]);
+        }
+}
+
+/*
+ * Run a read-only transaction which was never scheduled, against the versions 
+ * created before its epoch. The versions are looked up straight from the CC 
+ * threads' partitions, which only ever add newer versions on top of them 
+ * while the epoch is in flight. The versions can't be recycled under us 
+ * either: this thread has not finished the transaction's epoch, which holds 
+ * the low watermark below the epoch, and the versions are only garbage once 
+ * the epoch of their successors completes. Hash chain links of superseded 
+ * versions stay intact for the same reason (see GarbageBin).
+ *
+ * The read is at the end of the previous epoch rather than at the low 
+ * watermark, the last epoch every executor has substantiated. Versions 
+ * visible at the watermark may be superseded by an epoch below this one, and 
+ * recycled as soon as the watermark moves past it, which it can while the 
+ * read is running. The price is that the previous epoch's writers may not 
+ * have run yet, in which case they are run (or waited on) first.
+ */
+bool Executor::run_snapshot(mv_action *action, mv_action **blocker)
+{
+        assert(action->__state == PROCESSING);
+        assert(action->__snapshot == true && config.tables != NULL);
+
+        uint32_t num_reads, i;
+        uint64_t version;
+        CompositeKey *key;
+        mv_action *writer;
+
+        version = action->__version - 1;
+        num_reads = action->__readset.size();
+        if (action->read_index == 0)
+                snapshot_lookup(config.tables, action, version);
+        for (; action->read_index < num_reads; action->read_index += 1) {
+                i = action->read_index;
+                key = &action->__readset[i];
+                assert(key->value != NULL);
+                writer = key->value->writer;
+                if (writer != NULL && writer->__state != SUBSTANTIATED &&
+                    !ProcessSingle(writer)) {
+                        if (blocker != NULL)
+                                *blocker = writer;
+                        return false;
+                }
+        }
+        action->exec = this;
+        action->Run();
+        xchgq(&action->__state, SUBSTANTIATED);
+        WakeWaiters(action);
+        if (config.partitionNodes != NULL)
+                CountAccesses(action);
+        return true;
+}
+
 /* 
  * Check that a transaction's conflicting predecessors have finished executing, 
  * and then execute the transaction. 
  */
-bool Executor::ProcessTxn(mv_action *action) 
+bool Executor::ProcessTxn(mv_action *action, mv_action **blocker) 
 {
         assert(action != NULL && action->__state == PROCESSING);
         
         uint32_t num_writes, i;
         MVRecord *pred_version;
 
+        if (action->__snapshot == true)
+                return run_snapshot(action, blocker);
         if (action->__readonly == true) 
                 return run_readonly(action);
         
-        if (check_ready(action) == false)
+        if (check_ready(action, blocker) == false)
                 return false;
         
         action->exec = this;
         action->Run();
         xchgq(&action->__state, SUBSTANTIATED);
+        WakeWaiters(action);
+        if (config.partitionNodes != NULL)
+                CountAccesses(action);
 
         /* Register over-written versions for garbage collection */
         num_writes = action->__writeset.size();
@@ -443,27 +826,26 @@ GarbageBin::GarbageBin(GarbageBinConfig config)
         this->config = config;
         this->snapshotEpoch = 0;
 
-        // total number of structs
-        uint32_t numStructs = 
-                (config.numCCThreads + config.numWorkers*config.numTables);
         uint32_t ccOffset = config.numCCThreads*sizeof(MVRecordList);
         uint32_t workerOffset = 
                 config.numWorkers*config.numTables*sizeof(MVRecordList);
 
-        // twice #structs: one for live, one for snapshot
-        void *data = alloc_mem(2*numStructs*sizeof(MVRecordList), config.cpu);
-        memset(data, 0x00, 2*numStructs*sizeof(MVRecordList));
+        // ready stickies, and twice the records: one for live, one for snapshot
+        void *data = alloc_mem(ccOffset + 2*workerOffset, config.cpu);
+        memset(data, 0x00, ccOffset + 2*workerOffset);
   
-        this->curStickies = (MVRecordList*)data;
-        this->snapshotStickies = (MVRecordList*)((char*)data + ccOffset);
-        for (uint32_t i = 0; i < 2*config.numCCThreads; ++i) {
-                curStickies[i].tail = &curStickies[i].head;
-                curStickies[i].head = NULL;
-                curStickies[i].count = 0;
+        this->curStickies = new std::vector<MVRecord*>[config.numCCThreads];
+        this->snapshotStickies = 
+                new std::vector<MVRecord*>[config.numCCThreads];
+        this->readyStickies = (MVRecordList*)data;
+        for (uint32_t i = 0; i < config.numCCThreads; ++i) {
+                readyStickies[i].tail = &readyStickies[i].head;
+                readyStickies[i].head = NULL;
+                readyStickies[i].count = 0;
         }
   
-        this->curRecords = (RecordList*)((char*)data + 2*ccOffset);
-        this->snapshotRecords = (RecordList*)((char*)data + 2*ccOffset+workerOffset);
+        this->curRecords = (RecordList*)((char*)data + ccOffset);
+        this->snapshotRecords = (RecordList*)((char*)data + ccOffset+workerOffset);
         for (uint32_t i = 0; i < 2*config.numWorkers; ++i) {
                 curRecords[i].tail = &curRecords[i].head;
                 curRecords[i].head = NULL;
@@ -473,12 +855,7 @@ GarbageBin::GarbageBin(GarbageBinConfig config)
 
 void GarbageBin::AddMVRecord(uint32_t ccThread, MVRecord *rec) 
 {
-        rec->allocLink = NULL;
-        // rec->allocLink = NULL;
-        *(curStickies[ccThread].tail) = rec;
-        curStickies[ccThread].tail = &rec->allocLink;
-        curStickies[ccThread].count += 1;
-        assert(curStickies[ccThread].head != NULL);
+        curStickies[ccThread].push_back(rec);
 }
 
 void GarbageBin::AddRecord(uint32_t workerThread, uint32_t tableId, 
@@ -492,25 +869,34 @@ void GarbageBin::AddRecord(uint32_t workerThread, uint32_t tableId,
 
 void GarbageBin::ReturnGarbage() 
 {
+        MVRecordList *ready;
+        MVRecord *rec;
+
         for (uint32_t i = 0; i < config.numCCThreads; ++i) {
-                // *curStickies[i].tail = NULL;
+                ready = &readyStickies[i];
+
+                // The snapshot is past the low watermark, no reader can reach
+                // its versions any more, so they can be linked for the 
+                // allocator.
+                for (size_t j = 0; j < snapshotStickies[i].size(); ++j) {
+                        rec = snapshotStickies[i][j];
+                        rec->allocLink = NULL;
+                        *(ready->tail) = rec;
+                        ready->tail = &rec->allocLink;
+                        ready->count += 1;
+                }
+                snapshotStickies[i].clear();
 
                 // Try to enqueue garbage. If enqueue fails, we'll just try again during the
                 // next call.
-                if (snapshotStickies[i].head != NULL) {
-                        if (!config.ccChannels[i]->Enqueue(snapshotStickies[i])) {
-                                *(curStickies[i].tail) = snapshotStickies[i].head;
-                                curStickies[i].tail = snapshotStickies[i].tail;
-                                curStickies[i].count += snapshotStickies[i].count;
-                        }
-                        else {
-                                //        std::cout << "Recycle!\n";
+                if (ready->head != NULL) {
+                        if (config.ccChannels[i]->Enqueue(*ready)) {
+                                ready->head = NULL;
+                                ready->tail = &ready->head;
+                                ready->count = 0;
                         }
                 }
-                snapshotStickies[i] = curStickies[i];
-                curStickies[i].head = NULL;
-                curStickies[i].tail = &curStickies[i].head;
-                curStickies[i].count = 0;
+                snapshotStickies[i].swap(curStickies[i]);
         }
 }
 
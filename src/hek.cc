@@ -76,18 +76,12 @@ hek_worker::hek_worker(hek_worker_config config) : Runnable(config.cpu)
 
 void hek_worker::insert_commit_queue(hek_action *txn)
 {
-        int me;
-        me = config.cpu;
-        SimpleQueue<hek_action*> *queue = txn->worker->config.commit_queues[me];
-        queue->EnqueueBlocking(txn);
+        txn->worker->config.commit_queue->EnqueueBlocking(txn);
 }
 
 void hek_worker::insert_abort_queue(hek_action *txn)
 {
-        int me;
-        me = config.cpu;
-        SimpleQueue<hek_action*> *queue = txn->worker->config.abort_queues[me];
-        queue->EnqueueBlocking(txn);
+        txn->worker->config.abort_queue->EnqueueBlocking(txn);
 }
 
 void hek_worker::Init()
@@ -172,28 +166,22 @@ void hek_worker::commit_dependent(hek_action *committed)
 // Check the result of dependent transactions.
 void hek_worker::check_dependents()
 {
-        hek_action *aborted, *committed;
-        uint32_t i;
-
-        for (i = 0; i < config.num_threads; ++i) {
-                //                if (i != config.cpu) {
-                        while (config.abort_queues[i]->Dequeue(&aborted))
-                                abort_dependent(aborted);
-                        //                } else {
-                        //                        assert(config.abort_queues[i]->Dequeue(&aborted)
-                        //                               == false);
-                        //                }
-        }
+        hek_action *txns[HEK_DEPENDENT_BATCH];
+        uint32_t num_txns, i;
 
-        for (i = 0; i < config.num_threads; ++i) {
-                //                if (i != config.cpu) {
-                        while (config.commit_queues[i]->Dequeue(&committed))
-                                commit_dependent(committed);
-                        //                } else {
-                        //                        assert(config.commit_queues[i]->Dequeue(&committed)
-                        //                               == false);
-                        //                }
-        }
+        /* A short run means the queue was drained. */
+        do {
+                num_txns = config.abort_queue->DequeueMany(txns,
+                                                           HEK_DEPENDENT_BATCH);
+                for (i = 0; i < num_txns; ++i)
+                        abort_dependent(txns[i]);
+        } while (num_txns == HEK_DEPENDENT_BATCH);
+        do {
+                num_txns = config.commit_queue->DequeueMany(txns,
+                                                            HEK_DEPENDENT_BATCH);
+                for (i = 0; i < num_txns; ++i)
+                        commit_dependent(txns[i]);
+        } while (num_txns == HEK_DEPENDENT_BATCH);
 }
 
 // Hekaton worker threads's "main" function.
@@ -526,6 +514,8 @@ void hek_worker::run_txn(hek_action *txn)
         txn->latch = 0;
         txn->worker = this;
         txn->dependents = NULL;
+        if (txn->start_time == 0)
+                txn->start_time = rdtsc();
         barrier();
         get_writes(txn);
         while (true) {
@@ -614,6 +604,8 @@ void hek_worker::do_commit(hek_action *txn)
         commit_waiters(txn);
         num_committed += 1;
         num_done += 1;
+        latencies.Record(rdtsc() - txn->start_time);
+        txn->start_time = 0;
 }
 
 void hek_worker::install_writes(hek_action *txn)
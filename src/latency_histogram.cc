@@ -0,0 +1,77 @@
+#include <latency_histogram.h>
+#include <machine.h>
+#include <cstring>
+
+LatencyHistogram::LatencyHistogram()
+{
+        Reset();
+}
+
+void LatencyHistogram::Reset()
+{
+        memset(counts, 0x0, sizeof(counts));
+        total = 0;
+}
+
+/* Midpoint of the values held by a bucket. */
+uint64_t LatencyHistogram::BucketValue(uint32_t bucket)
+{
+        uint32_t shift;
+        uint64_t low;
+
+        assert(bucket < LATENCY_BUCKETS);
+        if (bucket < LATENCY_SUB_BUCKETS)
+                return bucket;
+        shift = bucket / LATENCY_SUB_BUCKETS - 1;
+        low = ((uint64_t)LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS) <<
+                shift;
+        return low + ((((uint64_t)1) << shift) >> 1);
+}
+
+/* 
+ * The other histogram may still be recorded into, so its total is recomputed 
+ * from the counts read. 
+ */
+void LatencyHistogram::Merge(const LatencyHistogram &other)
+{
+        uint64_t count;
+        uint32_t i;
+
+        for (i = 0; i < LATENCY_BUCKETS; ++i) {
+                count = other.counts[i];
+                counts[i] += count;
+                total += count;
+        }
+}
+
+uint64_t LatencyHistogram::Percentile(double pct)
+{
+        uint64_t rank, seen;
+        uint32_t i;
+
+        if (total == 0)
+                return 0;
+        rank = (uint64_t)(pct*total/100.0);
+        if (rank >= total)
+                rank = total - 1;
+        seen = 0;
+        for (i = 0; i < LATENCY_BUCKETS; ++i) {
+                seen += counts[i];
+                if (seen > rank)
+                        break;
+        }
+        assert(i < LATENCY_BUCKETS);
+        return BucketValue(i);
+}
+
+void LatencyHistogram::WritePercentiles(std::ostream &out, const char *prefix)
+{
+        double cycles_per_micro;
+
+        cycles_per_micro = FREQUENCY / 1000000.0;
+        out << prefix << "p50:" << Percentile(50) / cycles_per_micro << " ";
+        out << prefix << "p90:" << Percentile(90) / cycles_per_micro << " ";
+        out << prefix << "p99:" << Percentile(99) / cycles_per_micro << " ";
+        out << prefix << "p99.9:" << Percentile(99.9) / cycles_per_micro << 
+                " ";
+}
@@ -6,6 +6,15 @@ LockManager::LockManager(LockManagerConfig config)
 {
         uint32_t i;
         table = new LockManagerTable(config);
+        policy = config.policy;
+        early_release = config.earlyRelease;
+
+        /* 
+         * Only txns which can't abort may release early, so released writes 
+         * never need to be undone. 
+         */
+        assert(!early_release || (config.keyHeaders && policy == LOCK_WAIT));
+        next_timestamp = 0;
         tableSizes = (uint64_t*)malloc(sizeof(uint64_t)*config.numTables);
         for (i = 0; i < config.numTables; ++i) 
                 tableSizes[i] = (uint64_t)config.tableSizes[i];
@@ -19,19 +28,56 @@ bool LockManager::LockRecord(locking_action *txn, struct locking_key *k)
         return table->Lock(k);
 }
 
-void LockManager::BlockingLockRecord(locking_action *txn, struct locking_key *k)
+void LockManager::WaitDependencies(locking_action *txn)
 {
         volatile uint64_t deps;
 
-        if (!LockRecord(txn, k)) {
-                while (true) {
-                        barrier();
-                        deps = txn->num_dependencies;
-                        barrier();
-                        if (deps == 0)
-                                break;
-                }
+        while (true) {
+                barrier();
+                deps = txn->num_dependencies;
+                barrier();
+                if (deps == 0)
+                        break;
+        }
+}
+
+void LockManager::BlockingLockRecord(locking_action *txn, struct locking_key *k)
+{
+        if (!LockRecord(txn, k)) 
+                WaitDependencies(txn);
+}
+
+/*
+ * Called once before txn's first execution attempt. Retries keep the 
+ * timestamp, so a txn which keeps dying eventually becomes the oldest.
+ */
+void LockManager::Begin(locking_action *txn)
+{
+        if (policy == LOCK_WAIT_DIE)
+                txn->timestamp = fetch_and_increment(&next_timestamp);
+}
+
+/*
+ * Acquire k while txn runs. If the policy doesn't allow txn to wait for k, 
+ * throws a locking_abort_exception, the caller must release txn's locks and 
+ * retry.
+ */
+void LockManager::AcquireRecord(locking_action *txn, struct locking_key *k)
+{
+        lock_status status;
+
+        if (policy == LOCK_WAIT) {
+                BlockingLockRecord(txn, k);
+                return;
         }
+        assert(k->dependency == txn && k->is_held == false);
+        k->next = NULL;
+        k->prev = NULL;
+        status = table->TryLock(k, policy);
+        if (status == LOCK_DENIED)
+                throw locking_abort_exception();
+        else if (status == LOCK_QUEUED)
+                WaitDependencies(txn);
 }
 
 bool LockManager::SortCmp(const locking_key &key1, const locking_key &key2)
@@ -86,16 +132,46 @@ bool LockManager::Lock(locking_action *txn)
         return acquired;
 }
 
+void LockManager::ReleaseEarly(locking_action *txn, struct locking_key *k)
+{
+        assert(early_release && k->dependency == txn);
+        table->Unlock(k, true);
+}
+
 void LockManager::Unlock(locking_action *txn)
 {
-        uint32_t i, num_writes, num_reads;
+        uint32_t i, num_writes, num_reads, num_deps;
+        bool all_held;
         
         num_writes = txn->writeset.size();
         num_reads = txn->readset.size();
+
+        /* 
+         * txn may have seen writes of txns which released early, it commits 
+         * after them. 
+         */
+        if (early_release) {
+                num_deps = txn->commit_deps.size();
+                for (i = 0; i < num_deps; ++i) 
+                        while (txn->commit_deps[i]->committed == false)
+                                do_pause();
+                txn->commit_deps.clear();
+                barrier();
+                txn->committed = true;
+                barrier();
+        }
+        
+        /* 
+         * Under LOCK_WAIT every key is locked, unless it was released early. 
+         * Otherwise, an aborted txn may not have reached some of its keys.
+         */
+        all_held = policy == LOCK_WAIT && !early_release;
         for (i = 0; i < num_writes; ++i) 
-                table->Unlock(&txn->writeset[i]);
+                if (all_held || txn->writeset[i].is_held)
+                        table->Unlock(&txn->writeset[i]);
         for (i = 0; i < num_reads; ++i) 
-                table->Unlock(&txn->readset[i]);
+                if (all_held || txn->readset[i].is_held)
+                        table->Unlock(&txn->readset[i]);
         txn->finished_execution = true;
 }
 
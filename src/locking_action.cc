@@ -16,6 +16,7 @@ locking_key::locking_key(uint64_t key, uint32_t table_id, bool is_write)
         this->latch = NULL;
         this->prev = NULL;
         this->next = NULL;
+        this->header = NULL;
         this->is_initialized = false;
         this->value = NULL;
 }
@@ -35,7 +36,10 @@ locking_action::locking_action(txn *txn) : translator(txn)
         this->prepared = false;
         this->read_index = 0;
         this->write_index = 0;
+        this->timestamp = 0;
         this->bufs = NULL;
+        this->num_acquired = 0;
+        this->committed = false;
 }
 
 void locking_action::add_write_key(uint64_t key, uint32_t table_id)
@@ -109,7 +113,8 @@ void* locking_action::write_ref(uint64_t key, uint32_t table_id)
         index = find_key(key, table_id, this->writeset);
         assert(index != -1 && index < this->writeset.size());
         k = &this->writeset[index];
-        mgr->BlockingLockRecord(this, k);
+        mgr->AcquireRecord(this, k);
+        acquired();
         if (k->value == NULL) {
                 read_value = lookup(k);
                 k->value = this->bufs->GetRecord(table_id);
@@ -127,12 +132,71 @@ void* locking_action::read(uint64_t key, uint32_t table_id)
         index = find_key(key, table_id, this->readset);
         assert(index != -1 && index < this->readset.size());
         k = &this->readset[index];
-        mgr->BlockingLockRecord(this, k);
+        mgr->AcquireRecord(this, k);
+        acquired();
         if (k->value == NULL) 
                 k->value = lookup(k);
         return k->value;
 }
 
+/*
+ * Called after each lock acquisition. Once the txn holds all of its locks, 
+ * keys it's already done with can be released. Releasing them any earlier 
+ * would break two-phase locking.
+ */
+void locking_action::acquired()
+{
+        uint32_t i, num_finished;
+
+        this->num_acquired += 1;
+        if (this->num_acquired < this->readset.size() + this->writeset.size())
+                return;
+        num_finished = this->finished.size();
+        for (i = 0; i < num_finished; ++i) 
+                release_key(this->finished[i]);
+        this->finished.clear();
+}
+
+/*
+ * Install k's write, if any, and hand its lock to the next waiter.
+ */
+void locking_action::release_key(locking_key *k)
+{
+        void *value;
+        uint32_t record_size;
+
+        if (k->is_write == true && k->value != NULL) {
+                value = lookup(k);
+                record_size = this->tables[k->table_id]->RecordSize();
+                memcpy(value, RECORD_VALUE_PTR(k->value), record_size);
+                this->bufs->ReturnRecord(k->table_id, k->value);
+                k->value = NULL;
+        }
+        mgr->ReleaseEarly(this, k);
+}
+
+void locking_action::release(uint64_t key, uint32_t table_id)
+{
+        locking_key *k;
+        int index;
+
+        if (mgr->EarlyRelease() == false)
+                return;
+        index = find_key(key, table_id, this->writeset);
+        if (index != -1) {
+                k = &this->writeset[index];
+        } else {
+                index = find_key(key, table_id, this->readset);
+                assert(index != -1);
+                k = &this->readset[index];
+        }
+        assert(k->is_held == true);
+        if (this->num_acquired == this->readset.size() + this->writeset.size())
+                release_key(k);
+        else
+                this->finished.push_back(k);
+}
+
 void locking_action::prepare()
 {
         if (this->prepared == true) 
@@ -266,7 +266,9 @@ mv_action::mv_action(txn *t) : translator(t)
         this->__version = 0;
         this->__combinedHash = 0;
         this->__readonly = false;
+        this->__snapshot = false;
         this->__state = STICKY;
+        this->start_time = 0;
         for (uint32_t i = 0; i < NUM_CC_THREADS; ++i) {
                 this->__write_starts.push_back(-1);
                 this->__read_starts.push_back(-1);
@@ -274,6 +276,9 @@ mv_action::mv_action(txn *t) : translator(t)
         this->init = false;
         this->read_index = 0;
         this->write_index = 0;
+        this->waiters = 0;
+        this->next_waiter = NULL;
+        this->parked_on = NULL;
 }
 
 bool mv_action::initialized()
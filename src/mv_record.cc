@@ -7,10 +7,12 @@
 uint64_t _MVRecord_::INFINITY = 0xFFFFFFFFFFFFFFFF;
 
 
-MVRecordAllocator::MVRecordAllocator(uint64_t size, int cpu, int worker_start, int worker_end) {
+MVRecordAllocator::MVRecordAllocator(uint64_t size, int cpu, int worker_start, int worker_end,
+                                     int recordCpu) {
         //  std::cout << "NUMA node: " << numa_node_of_cpu(cpu) << "\n";
         worker_start += 1;
         worker_end += 1;
+  assert(sizeof(MVRecord) == CACHE_LINE);
   if (size < 1) {
     size = 1;
   }
@@ -36,8 +38,11 @@ MVRecordAllocator::MVRecordAllocator(uint64_t size, int cpu, int worker_start, i
 
   //  char *recordData = (char*)alloc_mem(recordDataSize, 19);
   
-    char *recordData = (char*)alloc_interleaved_all(recordDataSize);
-  //char *recordData = (char*)alloc_mem(recordDataSize, recordCpu);
+  char *recordData;
+  if (recordCpu >= 0)
+    recordData = (char*)alloc_mem(recordDataSize, recordCpu);
+  else
+    recordData = (char*)alloc_interleaved_all(recordDataSize);
 
   //  char *recordData = (char*)alloc_interleaved(recordDataSize, worker_start, 79);
     assert(recordData != NULL);
@@ -81,9 +86,8 @@ bool MVRecordAllocator::GetRecord(MVRecord **OUT_recordPtr) {
 
   // Set up the MVRecord to return.
   //  memset(ret, 0xA3, sizeof(MVRecord));
-  ret->link = NULL;
+  ret->link = NULL;       // Also clears allocLink.
   ret->recordLink = NULL;
-  ret->allocLink = NULL;
   ret->epoch_ancestor = NULL;
   ret->writer = NULL;
   //  ret->value = NULL;
@@ -36,12 +36,28 @@ bool MVTable::WriteNewVersion(uint32_t partition, CompositeKey &pkey,
 
 MVTablePartition::MVTablePartition(uint64_t size, 
                                    int cpu,
-                                   MVRecordAllocator *alloc) {
+                                   MVRecordAllocator *alloc,
+                                   MVIndexType type) {
   if (size < 1) {
     size = 1;
   }
   this->numSlots = size;
   this->allocator = alloc;
+  this->indexType = type;
+  this->tableSlots = NULL;
+  this->numBuckets = 0;
+  this->buckets = NULL;
+
+  if (type == MV_BUCKET_INDEX) {
+    
+    // Keep the index at most half full so that probe sequences stay short.
+    this->numBuckets = (2*size + MV_BUCKET_ENTRIES - 1) / MV_BUCKET_ENTRIES;
+    this->buckets = 
+      (MVIndexBucket*)alloc_mem(sizeof(MVIndexBucket)*numBuckets, cpu);
+    assert(this->buckets != NULL);
+    memset(this->buckets, 0x0, sizeof(MVIndexBucket)*numBuckets);
+    return;
+  }
         
   // Allocate a contiguous chunk of memory in which to store the table's slots
   this->tableSlots = (MVRecord**)alloc_mem(sizeof(MVRecord*)*size, cpu);
@@ -51,25 +67,117 @@ MVTablePartition::MVTablePartition(uint64_t size,
   //  std::cout << "asldkjfasdf\n";
 }
 
+/*
+ * Find the version chain head of pkey in a bucketized index. If the key is not 
+ * present, return NULL, unless insert is set, in which case the first free 
+ * entry along the probe sequence is claimed for the key.
+ */
+MVRecord** MVTablePartition::GetBucketSlot(const CompositeKey &pkey, 
+                                           uint64_t slot,
+                                           bool insert) {
+  uint64_t index = slot;
+  MVIndexBucket *bucket;
+  uint32_t i;
+
+  for (uint64_t probes = 0; probes < numBuckets; ++probes) {
+    bucket = &buckets[index];
+    for (i = 0; i < MV_BUCKET_ENTRIES; ++i) {
+      if (bucket->heads[i] == NULL) {
+        if (insert == false) 
+          return NULL;
+        bucket->keys[i] = pkey.key;
+        return &bucket->heads[i];
+      } else if (bucket->keys[i] == pkey.key) {
+        return &bucket->heads[i];
+      }
+    }
+    index += 1;
+    if (index == numBuckets) 
+      index = 0;
+  }
+
+  // Every entry is taken, and none by the key. Partitions are sized to hold 
+  // twice their keys, see SetupSchedulers, so this is only reachable with a 
+  // key the partition wasn't sized for.
+  assert(insert == false);
+  return NULL;
+}
+
+/* Walk a single record's version chain to find the version visible at version. */
+static inline MVRecord* find_version(MVRecord *cur, uint64_t version) {
+  while (cur != NULL && cur->deleteTimestamp > version) {
+    // Found a valid version
+    if (cur->createTimestamp <= version && cur->deleteTimestamp > version) {
+      return cur;
+    }
+    cur = cur->recordLink;
+  }
+  return NULL;
+}
+
+/* 
+ * Hash the key to its slot (or its first bucket) and prefetch the slot. 
+ */
+uint64_t MVTablePartition::GetSlot(const CompositeKey &pkey) {
+  uint64_t slot = HashSlot(pkey);
+  if (indexType == MV_BUCKET_INDEX)
+    __builtin_prefetch(&buckets[slot], 1, 3);
+  else
+    __builtin_prefetch(&tableSlots[slot], 1, 3);
+  return slot;
+}
+
+/*
+ * Prefetch the latest version of the key. Must be called after the slot has 
+ * been prefetched, otherwise this stalls on the slot's miss.
+ */
+void MVTablePartition::PrefetchVersion(const CompositeKey &pkey, 
+                                       uint64_t slot) {
+  MVIndexBucket *bucket;
+  MVRecord *head;
+  uint32_t i;
+
+  head = NULL;
+  if (indexType == MV_BUCKET_INDEX) {
+    bucket = &buckets[slot];
+    for (i = 0; i < MV_BUCKET_ENTRIES; ++i) {
+      if (bucket->heads[i] == NULL || bucket->keys[i] == pkey.key) {
+        head = bucket->heads[i];
+        break;
+      }
+    }
+  } else {
+    
+    // Chains are short, the first record in the slot is most likely the key.
+    head = tableSlots[slot];
+  }
+  if (head != NULL) 
+    __builtin_prefetch(head, 1, 3);
+}
+
 MVRecord* MVTablePartition::GetMVRecord(const CompositeKey &pkey, 
                                         uint64_t version) {
-  // Get the slot number the record hashes to, and try to find if a previous
-  // version of the record already exists.
-  uint64_t slotNumber = CompositeKey::Hash(&pkey) % numSlots;
-  MVRecord *cur = tableSlots[slotNumber];
+  return GetMVRecord(pkey, version, HashSlot(pkey));
+}
+
+MVRecord* MVTablePartition::GetMVRecord(const CompositeKey &pkey, 
+                                        uint64_t version,
+                                        uint64_t slot) {
+  if (indexType == MV_BUCKET_INDEX) {
+    MVRecord **head = GetBucketSlot(pkey, slot, false);
+    if (head == NULL)
+      return NULL;
+    return find_version(*head, version);
+  }
+
+  // Try to find if a previous version of the record already exists.
+  MVRecord *cur = tableSlots[slot];
 
   while (cur != NULL) {
                 
     // We found the record. Link to the old record.
     if (cur->key == pkey.key) {
-      while (cur != NULL && cur->deleteTimestamp > version) {
-        // Found a valid version
-        if (cur->createTimestamp <= version && cur->deleteTimestamp > version) {
-          return cur;
-        }
-        cur = cur->recordLink;
-      }
-      break;
+      return find_version(cur, version);
     }
     cur = cur->link;
   }
@@ -156,6 +264,11 @@ bool MVTablePartition::GetLatestVersion(const CompositeKey &pkey,
  */
 bool MVTablePartition::WriteNewVersion(CompositeKey &pkey, mv_action *action, 
                                        uint64_t version) {
+  return WriteNewVersion(pkey, action, version, HashSlot(pkey));
+}
+
+bool MVTablePartition::WriteNewVersion(CompositeKey &pkey, mv_action *action, 
+                                       uint64_t version, uint64_t slot) {
 
   // Allocate an MVRecord to hold the new record.
   MVRecord *toAdd;
@@ -167,13 +280,30 @@ bool MVTablePartition::WriteNewVersion(CompositeKey &pkey, mv_action *action,
   toAdd->deleteTimestamp = MVRecord::INFINITY;
   toAdd->writer = action;
   toAdd->key = pkey.key;  
-
-  // Get the slot number the record hashes to, and try to find if a mvprevious
-  // version of the record already exists.
-  uint64_t slotNumber = CompositeKey::Hash(&pkey) % numSlots;
-  MVRecord *cur = tableSlots[slotNumber];
-  MVRecord **prev = &tableSlots[slotNumber];
   uint64_t epoch = GET_MV_EPOCH(version);
+
+  if (indexType == MV_BUCKET_INDEX) {
+    MVRecord **head = GetBucketSlot(pkey, slot, true);
+    MVRecord *cur = *head;
+    if (cur != NULL) {
+      toAdd->recordLink = cur;
+      if (GET_MV_EPOCH(cur->createTimestamp) == epoch)
+              toAdd->epoch_ancestor = cur->epoch_ancestor;
+      else
+              toAdd->epoch_ancestor = cur;
+    }
+
+    // Executors running snapshot reads walk the chains concurrently, publish
+    // the version only once it is initialized.
+    barrier();
+    *head = toAdd;
+    pkey.value = toAdd;
+    return true;
+  }
+
+  // Try to find if a previous version of the record already exists.
+  MVRecord *cur = tableSlots[slot];
+  MVRecord **prev = &tableSlots[slot];
   
   while (cur != NULL) {                
     // We found the record. Link to the old record.
@@ -190,6 +320,7 @@ bool MVTablePartition::WriteNewVersion(CompositeKey &pkey, mv_action *action,
     prev = &cur->link;
     cur = cur->link;
   }
+  barrier();
   *prev = toAdd;
   pkey.value = toAdd;
   return true;
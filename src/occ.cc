@@ -8,6 +8,13 @@ OCCWorker::OCCWorker(OCCWorkerConfig conf, struct RecordBuffersConfig rb_conf)
 {
         this->config = conf;
         this->bufs = new(conf.cpu) RecordBuffers(rb_conf);
+        this->logging = false;
+        this->num_durable = 0;
+        this->num_aborts = 0;
+        if (conf.log != NULL) {
+                this->log_buf = conf.log->free->DequeueBlocking();
+                this->log_buf.epoch = 0;
+        }
 }
 
 void OCCWorker::Init()
@@ -19,7 +26,7 @@ void OCCWorker::Init()
  */
 void OCCWorker::StartWorking()
 {
-        if (config.cpu == 0) {
+        if (config.cpu == 0 && config.epoch_deadline == NULL) {
                 EpochManager();
         } else {
                 TxnRunner();
@@ -47,11 +54,12 @@ uint32_t OCCWorker::exec_pending(OCCAction **pending_list)
         OCCAction *cur, *prev;
         uint32_t num_done;
         
+        TxnBoundary();
         prev = NULL;
         cur = *pending_list;
         num_done = 0;
         while (cur != NULL) {
-                if (RunSingle(cur)) {
+                if (!Deferred(cur) && RunSingle(cur)) {
                         if (prev == NULL) 
                                 *pending_list = cur->link;
                         else 
@@ -83,13 +91,16 @@ void OCCWorker::TxnRunner()
                                 assert(false);
                 config.outputQueue->EnqueueBlocking(input);                
         }
+
+        /* Loading the database isn't logged. */
+        logging = config.log != NULL;
         
         barrier();
         config.num_completed = 0;
         barrier();
 
         for (j = 0; j < 3 ; ++j) {
-                input = config.inputQueue->DequeueBlocking();
+                input = NextBatch();
                 if (j < 1) {
                         for (i = 0; i < input.batchSize; ++i) {
                                 while (num_pending >= 50) 
@@ -106,6 +117,8 @@ void OCCWorker::TxnRunner()
                         output.batchSize = input.batchSize;
                         config.outputQueue->EnqueueBlocking(output);
                 } else {
+                        /* Only measure txns from the real run on. */
+                        latencies.Reset();
                         uint32_t batch_sz = input.batchSize;
                         for (i = 0; ; ++i) {
                                 while (num_pending >= 50)
@@ -121,6 +134,39 @@ void OCCWorker::TxnRunner()
         
 }
 
+/* Wait for the next batch, keeping up with the epoch meanwhile. */
+OCCActionBatch OCCWorker::NextBatch()
+{
+        OCCActionBatch ret;
+
+        while (!config.inputQueue->Dequeue(&ret)) {
+                TxnBoundary();
+                do_pause();
+        }
+        return ret;
+}
+
+/*
+ * Called before every txn and while idle. Advances the epoch if its deadline 
+ * has passed, so that epochs keep moving when every worker is idle. Publishes 
+ * the current epoch to the logger, so that a worker which doesn't commit 
+ * doesn't hold back the durable epoch.
+ */
+void OCCWorker::TxnBoundary()
+{
+        uint32_t epoch;
+
+        if (config.epoch_deadline != NULL)
+                AdvanceEpoch();
+        if (logging) {
+                barrier();
+                epoch = *config.epoch_ptr;
+                barrier();
+                PublishEpoch(epoch);
+                AckDurable();
+        }
+}
+
 void OCCWorker::UpdateEpoch()
 {
         uint32_t temp;
@@ -128,12 +174,38 @@ void OCCWorker::UpdateEpoch()
         volatile uint64_t now = rdtsc();
         barrier();
         if (now - incr_timestamp > config.epoch_threshold) {                
+                if (config.write_filter != NULL)
+                        config.write_filter->Prepare(*config.epoch_ptr + 2);
                 temp = fetch_and_increment_32(config.epoch_ptr);                
                 incr_timestamp = now;
                 assert(temp != 0);
         }
 }
 
+/*
+ * Called by every worker between txns and while idle when there is no epoch 
+ * thread. Whoever first sees the deadline pass advances the epoch. The 
+ * deadline reads as never while it does, so advances don't overlap.
+ */
+void OCCWorker::AdvanceEpoch()
+{
+        uint64_t now, deadline;
+
+        barrier();
+        deadline = *config.epoch_deadline;
+        barrier();
+        now = rdtsc();
+        if (now >= deadline &&
+            cmp_and_swap(config.epoch_deadline, deadline, OCC_NO_DEADLINE)) {
+                if (config.write_filter != NULL)
+                        config.write_filter->Prepare(*config.epoch_ptr + 2);
+                fetch_and_increment_32(config.epoch_ptr);
+                barrier();
+                *config.epoch_deadline = now + config.epoch_threshold;
+                barrier();
+        }
+}
+
 uint64_t OCCWorker::NumCompleted()
 {
         uint64_t ret;
@@ -143,6 +215,150 @@ uint64_t OCCWorker::NumCompleted()
         return ret;
 }
 
+uint64_t OCCWorker::NumAborts()
+{
+        uint64_t ret;
+        barrier();
+        ret = num_aborts;
+        barrier();
+        return ret;
+}
+
+/*
+ * Back off exponentially in the number of times the action aborted, with
+ * jitter so that txns which conflicted don't retry in lockstep. If the record
+ * it conflicted on is locked, also wait for its TID to change.
+ */
+void OCCWorker::ScheduleRetry(OCCAction *action,
+                              const occ_validation_exception &e)
+{
+        volatile uint64_t *tid_ptr;
+        uint64_t delay, tid;
+        uint32_t shift;
+
+        shift = action->num_aborts - 1;
+        if (shift > OCC_BACKOFF_MAX_SHIFT)
+                shift = OCC_BACKOFF_MAX_SHIFT;
+        delay = config.backoff << shift;
+        action->retry_at = rdtsc() + delay/2 + 
+                (uint64_t)gen_random() % (delay/2 + 1);
+        tid_ptr = (volatile uint64_t*)config.tables[e.table_id]->Get(e.key);
+        barrier();
+        tid = *tid_ptr;
+        barrier();
+        if (IS_LOCKED(tid)) {
+                action->conflict_ptr = tid_ptr;
+                action->conflict_tid = tid;
+        } else {
+                action->conflict_ptr = NULL;
+        }
+}
+
+/* True if a pending action shouldn't be retried yet. */
+bool OCCWorker::Deferred(OCCAction *action)
+{
+        uint64_t tid;
+
+        if (action->retry_at > rdtsc())
+                return true;
+        if (action->conflict_ptr != NULL) {
+                barrier();
+                tid = *action->conflict_ptr;
+                barrier();
+                if (tid == action->conflict_tid)
+                        return true;
+                action->conflict_ptr = NULL;
+        }
+        return false;
+}
+
+uint64_t OCCWorker::NumDurable()
+{
+        uint64_t ret;
+        barrier();
+        ret = num_durable;
+        barrier();
+        return ret;
+}
+
+/*
+ * Move the log channel on to a new epoch. The open buffer holds commits of 
+ * earlier epochs only, so it's handed to the logger first.
+ */
+void OCCWorker::PublishEpoch(uint32_t epoch)
+{
+        if (epoch == log_buf.epoch)
+                return;
+        if (log_buf.size > 0) {
+                config.log->full->EnqueueBlocking(log_buf);
+                log_buf = config.log->free->DequeueBlocking();
+        }
+        log_buf.epoch = epoch;
+        barrier();
+        config.log->epoch = epoch;
+        barrier();
+}
+
+/*
+ * Append the action's writes to the log buffer of its epoch. A buffer is 
+ * handed to the logger when it's full, or when the worker moves on to a new 
+ * epoch.
+ */
+void OCCWorker::LogWrites(OCCAction *action, uint32_t epoch)
+{
+        occ_composite_key *k;
+        occ_log_header *header;
+        uint32_t i, num_writes, record_len;
+        uint64_t entry_len;
+
+        PublishEpoch(epoch);
+        num_writes = action->writeset.size();
+        for (i = 0; i < num_writes; ++i) {
+                k = &action->writeset[i];
+                record_len = config.tables[k->tableId]->RecordSize() - 
+                        sizeof(uint64_t);
+                entry_len = sizeof(occ_log_header) + record_len;
+                assert(entry_len <= log_buf.capacity);
+                if (log_buf.size + entry_len > log_buf.capacity) {
+                        config.log->full->EnqueueBlocking(log_buf);
+                        log_buf = config.log->free->DequeueBlocking();
+                        log_buf.epoch = epoch;
+                }
+                header = (occ_log_header*)&log_buf.data[log_buf.size];
+                header->table_id = k->tableId;
+                header->key = k->key;
+                header->tid = action->tid;
+                header->record_len = record_len;
+                memcpy(&log_buf.data[log_buf.size + sizeof(occ_log_header)],
+                       RECORD_VALUE_PTR(k->value), record_len);
+                log_buf.size += entry_len;
+        }
+}
+
+/* Acknowledge the commits of epochs the logger has made durable. */
+void OCCWorker::AckDurable()
+{
+        uint32_t durable;
+
+        barrier();
+        durable = *config.durable_epoch;
+        barrier();
+        while (!undurable.empty() && undurable.front().first <= durable) {
+                num_durable += undurable.front().second;
+                undurable.pop_front();
+        }
+}
+
+/* Count a commit in the given epoch, and acknowledge durable ones. */
+void OCCWorker::AckCommit(uint32_t epoch)
+{
+        AckDurable();
+        if (!undurable.empty() && undurable.back().first == epoch)
+                undurable.back().second += 1;
+        else
+                undurable.push_back(std::make_pair(epoch, (uint64_t)1));
+}
+
 /*
  * Run the action to completion. If the transaction aborts due to a conflict, 
  * retry.
@@ -155,6 +371,14 @@ bool OCCWorker::RunSingle(OCCAction *action)
         action->set_tables(this->config.tables, this->config.lock_tables);
         action->set_allocator(this->bufs);
         action->worker = this;
+        TxnBoundary();
+        if (action->start_time == 0)
+                action->start_time = rdtsc();
+        action->write_filter = config.write_filter;
+        action->temperature = config.temperature;
+        barrier();
+        action->start_epoch = *config.epoch_ptr;
+        barrier();
 
         try {
                 action->run();
@@ -163,20 +387,35 @@ bool OCCWorker::RunSingle(OCCAction *action)
                 epoch = *config.epoch_ptr;
                 barrier();                        
                 if (!READ_COMMITTED) {
-                        action->validate();
+                        if (config.write_filter != NULL)
+                                action->publish_writes(epoch);
+                        action->validate(epoch);
                         this->last_tid = action->compute_tid(epoch,
                                                              this->last_tid);
                 }
                 action->install_writes();
+                if (logging) {
+                        LogWrites(action, epoch);
+                        AckCommit(epoch);
+                }
                 action->cleanup();
                 fetch_and_increment(&config.num_completed);
+                latencies.Record(rdtsc() - action->start_time);
+                action->start_time = 0;
+                action->num_aborts = 0;
                 validated = true;
         } catch(const occ_validation_exception &e) {
                 if (READ_COMMITTED)
                         assert(false);
-                if (e.err == VALIDATION_ERR)
-                        action->release_locks();
+                action->release_locks();
+                if (config.temperature != NULL)
+                        config.temperature->Heat(*config.epoch_ptr, e.table_id,
+                                                 e.key);
                 action->cleanup();
+                num_aborts += 1;
+                action->num_aborts += 1;
+                if (config.backoff > 0)
+                        ScheduleRetry(action, e);
                 validated = false;
         }        
         return validated;
@@ -130,8 +130,17 @@ void OCCAction::add_read_key(uint32_t tableId, uint64_t key)
         readset.push_back(k);
 }
 
-OCCAction::OCCAction(txn *txn) : translator(txn)
+OCCAction::OCCAction(txn *txn) : translator(txn), max_hot(0, 0, false)
 {
+        this->start_time = 0;
+        this->write_filter = NULL;
+        this->start_epoch = 0;
+        this->temperature = NULL;
+        this->num_hot = 0;
+        this->num_aborts = 0;
+        this->retry_at = 0;
+        this->conflict_ptr = NULL;
+        this->conflict_tid = 0;
 }
 
 void OCCAction::add_write_key(uint32_t tableId, uint64_t key, bool is_rmw)
@@ -166,6 +175,11 @@ uint64_t OCCAction::stable_copy(uint64_t key, uint32_t table_id, void *record)
                 barrier();
                 ret = *tid_ptr;
                 barrier();
+
+                /* Waiting with hot records locked could deadlock. */
+                if (IS_LOCKED(ret) && this->num_hot > 0)
+                        throw occ_validation_exception(READ_ERR, table_id,
+                                                       key);
                 if (!IS_LOCKED(ret)) {
                         memcpy(RECORD_VALUE_PTR(record),
                                RECORD_VALUE_PTR(value), record_size);
@@ -177,7 +191,8 @@ uint64_t OCCAction::stable_copy(uint64_t key, uint32_t table_id, void *record)
                         else if (READ_COMMITTED)
                                 continue;
                         else
-                                throw occ_validation_exception(READ_ERR);
+                                throw occ_validation_exception(READ_ERR,
+                                                               table_id, key);
                         return ret;
                 }
         }
@@ -189,7 +204,10 @@ void OCCAction::validate_single(occ_composite_key &comp_key)
         void *value;
         volatile uint64_t *version_ptr;
         uint64_t cur_tid;
-        
+
+        /* A hot read which has been locked since it was read. */
+        if (comp_key.is_locked && !comp_key.is_rmw)
+                return;
         value = tables[comp_key.tableId]->Get(comp_key.key);
         version_ptr = (volatile uint64_t*)value;
         barrier();
@@ -198,16 +216,89 @@ void OCCAction::validate_single(occ_composite_key &comp_key)
 
         if ((GET_TIMESTAMP(cur_tid) != comp_key.old_tid) ||
             (IS_LOCKED(cur_tid) && !comp_key.is_rmw))
-                throw occ_validation_exception(VALIDATION_ERR);
+                throw occ_validation_exception(VALIDATION_ERR,
+                                               comp_key.tableId, comp_key.key);
+}
+
+/*
+ * Lock a record at its first access. Locks in key order wait, a lock below
+ * one already held is only tried, so hot locks can't deadlock. Returns false
+ * if the lock wasn't taken, and the record is read optimistically.
+ */
+bool OCCAction::lock_hot(occ_composite_key &comp_key)
+{
+        volatile uint64_t *lock_ptr;
+
+        assert(!READ_COMMITTED);
+        assert(comp_key.is_locked == false);
+        lock_ptr = (volatile uint64_t*)
+                this->tables[comp_key.tableId]->Get(comp_key.key);
+        if (this->num_hot == 0 || this->max_hot < comp_key)
+                acquire_single(lock_ptr);
+        else if (!try_acquire_single(lock_ptr))
+                return false;
+        if (this->num_hot == 0 || this->max_hot < comp_key)
+                this->max_hot = comp_key;
+        this->num_hot += 1;
+        comp_key.is_locked = true;
+        return true;
+}
+
+/* Copy a record this txn has locked, and return its TID. */
+uint64_t OCCAction::locked_copy(occ_composite_key &comp_key, void *record)
+{
+        Table *table;
+        void *value;
+        uint32_t record_size;
+
+        assert(comp_key.is_locked);
+        table = this->tables[comp_key.tableId];
+        value = table->Get(comp_key.key);
+        record_size = REAL_RECORD_SIZE(table->RecordSize());
+        memcpy(RECORD_VALUE_PTR(record), RECORD_VALUE_PTR(value), record_size);
+        return GET_TIMESTAMP(*(volatile uint64_t*)value);
 }
 
-void OCCAction::validate()
+/*
+ * Add the write set to the filter of the commit epoch. Must happen after the
+ * write set is locked and before validation.
+ */
+void OCCAction::publish_writes(uint32_t epoch)
+{
+        uint32_t i, num_writes;
+
+        num_writes = this->writeset.size();
+        for (i = 0; i < num_writes; ++i)
+                this->write_filter->Insert(epoch, this->writeset[i].tableId,
+                                           this->writeset[i].key);
+}
+
+void OCCAction::validate(uint32_t epoch)
 {
         uint32_t num_reads, num_writes, i;
+        bool filtered;
 
+        /* 
+         * Keys missing from the filters of every epoch since the txn started 
+         * weren't written since it read them.
+         */
         num_reads = this->readset.size();
-        for (i = 0; i < num_reads; ++i) 
-                validate_single(this->readset[i]);
+        filtered = this->write_filter != NULL && 
+                num_reads >= OCC_FILTER_MIN_READS &&
+                this->write_filter->Covers(this->start_epoch, epoch);
+        if (filtered) {
+                for (i = 0; i < num_reads; ++i)
+                        if (this->write_filter->MayContain(this->start_epoch,
+                                                           epoch,
+                                                           readset[i].tableId,
+                                                           readset[i].key))
+                                validate_single(this->readset[i]);
+                filtered = this->write_filter->Covers(this->start_epoch, 
+                                                      epoch);
+        }
+        if (!filtered)
+                for (i = 0; i < num_reads; ++i) 
+                        validate_single(this->readset[i]);
         num_writes = this->writeset.size();
         for (i = 0; i < num_writes; ++i)
                 if (this->writeset[i].is_rmw)
@@ -234,8 +325,14 @@ void* OCCAction::write_ref(uint64_t key, uint32_t table_id)
                 record = this->record_alloc->GetRecord(table_id);
                 comp_key->is_initialized = true;
                 comp_key->value = record;
+                if (this->temperature != NULL &&
+                    this->temperature->IsHot(this->start_epoch, table_id, key))
+                        lock_hot(*comp_key);
                 if (writeset[i].is_rmw == true) {
-                        tid = stable_copy(key, table_id, record);
+                        if (comp_key->is_locked)
+                                tid = locked_copy(*comp_key, record);
+                        else
+                                tid = stable_copy(key, table_id, record);
                         comp_key->old_tid = tid;
                 }
         } 
@@ -269,7 +366,12 @@ void* OCCAction::read(uint64_t key, uint32_t table_id)
                 record = this->record_alloc->GetRecord(table_id);
                 comp_key->is_initialized = true;
                 comp_key->value = record;
-                tid = stable_copy(key, table_id, record);
+                if (this->temperature != NULL &&
+                    this->temperature->IsHot(this->start_epoch, table_id, key) &&
+                    lock_hot(*comp_key))
+                        tid = locked_copy(*comp_key, record);
+                else
+                        tid = stable_copy(key, table_id, record);
                 comp_key->old_tid = tid;
         }        
         return RECORD_VALUE_PTR(comp_key->value);
@@ -285,34 +387,56 @@ void OCCAction::acquire_locks()
         std::sort(this->writeset.begin(), this->writeset.end());
 
         for (i = 0; i < num_writes; ++i) {
-                assert(this->writeset[i].is_locked == false);
+                if (this->writeset[i].is_locked == true)
+                        continue;
                 table_id = this->writeset[i].tableId;
                 key = this->writeset[i].key;
                 if (READ_COMMITTED)
                         value = this->lock_tables[table_id]->GetAlways(key);
                 else
                         value = this->tables[table_id]->GetAlways(key);
-                acquire_single((volatile uint64_t*)value);
+
+                /* Keys below a held hot lock are out of order, don't wait. */
+                if (this->num_hot > 0 && this->writeset[i] < this->max_hot) {
+                        if (!try_acquire_single((volatile uint64_t*)value))
+                                throw occ_validation_exception(VALIDATION_ERR,
+                                                               table_id, key);
+                } else {
+                        acquire_single((volatile uint64_t*)value);
+                }
                 this->writeset[i].is_locked = true;
         }
 
 }
 
+/* Release every lock an aborted txn holds, hot locks included. */
 void OCCAction::release_locks()
 {
-        uint32_t i, num_writes, table_id;
+        uint32_t i, num_writes, num_reads, table_id;
         uint64_t key;
         void *value;
 
         num_writes = this->writeset.size();
         for (i = 0; i < num_writes; ++i) {
-                assert(this->writeset[i].is_locked == true);
+                if (this->writeset[i].is_locked == false)
+                        continue;
                 table_id = this->writeset[i].tableId;
                 key = this->writeset[i].key;
                 value = this->tables[table_id]->Get(key);
                 release_single((volatile uint64_t*)value);
                 this->writeset[i].is_locked = false;
         }
+        num_reads = this->readset.size();
+        for (i = 0; i < num_reads; ++i) {
+                if (this->readset[i].is_locked == false)
+                        continue;
+                table_id = this->readset[i].tableId;
+                key = this->readset[i].key;
+                value = this->tables[table_id]->Get(key);
+                release_single((volatile uint64_t*)value);
+                this->readset[i].is_locked = false;
+        }
+        this->num_hot = 0;
 }
 
 void OCCAction::cleanup_single(occ_composite_key &comp_key)
@@ -407,8 +531,25 @@ void OCCAction::install_single_write(occ_composite_key &comp_key)
 
 void OCCAction::install_writes()
 {
-        uint32_t i, num_writes;
+        uint32_t i, num_writes, num_reads, table_id;
+        uint64_t key;
+        void *value;
         num_writes = this->writeset.size();
         for (i = 0; i < num_writes; ++i) 
                 install_single_write(this->writeset[i]);        
+
+        /* Hot reads stay locked until the txn commits. */
+        if (this->num_hot > 0) {
+                num_reads = this->readset.size();
+                for (i = 0; i < num_reads; ++i) {
+                        if (this->readset[i].is_locked == false)
+                                continue;
+                        table_id = this->readset[i].tableId;
+                        key = this->readset[i].key;
+                        value = this->tables[table_id]->Get(key);
+                        release_single((volatile uint64_t*)value);
+                        this->readset[i].is_locked = false;
+                }
+                this->num_hot = 0;
+        }
 }
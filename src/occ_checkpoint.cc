@@ -0,0 +1,284 @@
+#include <occ_checkpoint.h>
+#include <occ_action.h>
+#include <util.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+/* Buckets [first, last) of a table which belong to a partition. */
+static void partition_range(uint64_t num_buckets, uint32_t partition,
+                            uint64_t *first, uint64_t *last)
+{
+        *first = (num_buckets*partition) / OCC_CKPT_PARTITIONS;
+        *last = (num_buckets*(partition+1)) / OCC_CKPT_PARTITIONS;
+}
+
+OCCCheckpointer::OCCCheckpointer(OCCCheckpointerConfig config)
+        : Runnable(config.cpu)
+{
+        assert(config.num_tables <= OCC_CKPT_MAX_TABLES);
+        this->config = config;
+}
+
+void OCCCheckpointer::Init()
+{
+}
+
+/*
+ * Copy a record into buf without holding its lock. Retries until the TID is
+ * unlocked and unchanged across the copy, so buf holds a committed value and
+ * the TID it was written with.
+ */
+uint64_t OCCCheckpointer::WriteRecord(FILE *file, Table *table,
+                                      TableRecord *rec, char *buf)
+{
+        uint64_t value_sz, tid;
+        volatile uint64_t *tid_ptr;
+        size_t ret;
+
+        value_sz = table->RecordSize();
+        tid_ptr = RECORD_TID_PTR(rec->value);
+        memcpy(buf, &rec->key, sizeof(uint64_t));
+        while (true) {
+                barrier();
+                tid = *tid_ptr;
+                barrier();
+                if (IS_LOCKED(tid)) {
+                        do_pause();
+                        continue;
+                }
+                memcpy(&buf[sizeof(uint64_t)], rec->value, value_sz);
+                barrier();
+                if (tid == *tid_ptr)
+                        break;
+        }
+        *(uint64_t*)&buf[sizeof(uint64_t)] = tid;
+        ret = fwrite(buf, sizeof(uint64_t) + value_sz, 1, file);
+        assert(ret == 1);
+        return sizeof(uint64_t) + value_sz;
+}
+
+void OCCCheckpointer::StartWorking()
+{
+        occ_ckpt_header header;
+        occ_ckpt_table *desc;
+        TableRecord *rec;
+        Table *table;
+        FILE *file;
+        char *buf;
+        uint64_t offset, first, last, i, max_sz;
+        uint32_t j, k;
+        int err;
+
+        memset(&header, 0x0, sizeof(header));
+        header.magic = OCC_CKPT_MAGIC;
+        header.num_tables = config.num_tables;
+        barrier();
+        header.begin_epoch = *config.epoch_ptr;
+        barrier();
+
+        file = fopen(config.path, "w");
+        assert(file != NULL);
+        err = fseek(file, sizeof(header), SEEK_SET);
+        assert(err == 0);
+
+        max_sz = 0;
+        for (j = 0; j < config.num_tables; ++j)
+                if (config.tables[j]->RecordSize() > max_sz)
+                        max_sz = config.tables[j]->RecordSize();
+        buf = (char*)malloc(sizeof(uint64_t) + max_sz);
+        assert(buf != NULL);
+
+        offset = sizeof(header);
+        for (j = 0; j < config.num_tables; ++j) {
+                table = config.tables[j];
+                desc = &header.tables[j];
+                desc->num_buckets = table->NumBuckets();
+                desc->value_sz = table->RecordSize();
+                for (k = 0; k < OCC_CKPT_PARTITIONS; ++k) {
+                        desc->offsets[k] = offset;
+                        partition_range(desc->num_buckets, k, &first, &last);
+                        for (i = first; i < last; ++i) {
+                                rec = table->GetBucket(i);
+                                for (; rec != NULL; rec = rec->next) {
+                                        offset += WriteRecord(file, table, rec,
+                                                              buf);
+                                        desc->counts[k] += 1;
+                                }
+                        }
+                }
+        }
+        free(buf);
+
+        /* The header goes last, an image without one is never loaded. */
+        barrier();
+        header.end_epoch = *config.epoch_ptr;
+        barrier();
+        err = fflush(file);
+        assert(err == 0);
+        err = fdatasync(fileno(file));
+        assert(err == 0);
+        err = fseek(file, 0, SEEK_SET);
+        assert(err == 0);
+        err = fwrite(&header, sizeof(header), 1, file);
+        assert(err == 1);
+        err = fflush(file);
+        assert(err == 0);
+        err = fdatasync(fileno(file));
+        assert(err == 0);
+        fclose(file);
+        std::cerr << "Checkpoint epochs: " << header.begin_epoch << "-";
+        std::cerr << header.end_epoch << "\n";
+}
+
+struct occ_ckpt_partition {
+        Table *table;
+        uint64_t offset;
+        uint64_t count;
+        uint64_t value_sz;
+        TableRecord *records;
+};
+
+struct OCCCheckpointLoaderConfig {
+        int cpu;
+        int fd;
+        occ_ckpt_partition *partitions;
+        uint32_t num_partitions;
+        uint32_t thread_id;
+        uint32_t num_threads;
+};
+
+/*
+ * Restores every num_threads'th partition of an image. Partitions cover
+ * disjoint bucket ranges, so loaders never touch the same bucket.
+ */
+class OCCCheckpointLoader : public Runnable {
+ private:
+        OCCCheckpointLoaderConfig config;
+
+        void LoadPartition(occ_ckpt_partition *partition, char *buf)
+        {
+                TableRecord *rec, *next;
+                uint64_t entry_sz, i;
+                ssize_t ret;
+
+                entry_sz = sizeof(uint64_t) + partition->value_sz;
+                rec = partition->records;
+                for (i = 0; i < partition->count; ++i) {
+                        ret = pread(config.fd, buf, entry_sz,
+                                    partition->offset + i*entry_sz);
+                        assert(ret == (ssize_t)entry_sz);
+                        assert(rec != NULL);
+                        next = rec->next;
+                        memcpy(&rec->key, buf, sizeof(uint64_t));
+                        memcpy(rec->value, &buf[sizeof(uint64_t)],
+                               partition->value_sz);
+                        partition->table->InsertRecord(rec);
+                        rec = next;
+                }
+        }
+
+ protected:
+        virtual void Init()
+        {
+        }
+
+        virtual void StartWorking()
+        {
+                uint64_t max_sz;
+                uint32_t i;
+                char *buf;
+
+                max_sz = 0;
+                for (i = 0; i < config.num_partitions; ++i)
+                        if (config.partitions[i].value_sz > max_sz)
+                                max_sz = config.partitions[i].value_sz;
+                buf = (char*)malloc(sizeof(uint64_t) + max_sz);
+                assert(buf != NULL);
+                for (i = config.thread_id; i < config.num_partitions;
+                     i += config.num_threads)
+                        LoadPartition(&config.partitions[i], buf);
+                free(buf);
+        }
+
+ public:
+        void* operator new(std::size_t sz, int cpu)
+        {
+                return alloc_mem(sz, cpu);
+        }
+
+        OCCCheckpointLoader(OCCCheckpointLoaderConfig config)
+                : Runnable(config.cpu)
+        {
+                this->config = config;
+        }
+};
+
+uint32_t occ_load_checkpoint(const char *path, Table **tables,
+                             uint32_t num_tables, uint32_t num_threads)
+{
+        occ_ckpt_header header;
+        occ_ckpt_partition *partitions;
+        OCCCheckpointLoader **loaders;
+        occ_ckpt_table *desc;
+        uint32_t i, j, num_partitions;
+        ssize_t ret;
+        int fd;
+
+        assert(num_threads > 0);
+        fd = open(path, O_RDONLY);
+        assert(fd >= 0);
+        ret = pread(fd, &header, sizeof(header), 0);
+        assert(ret == sizeof(header));
+        assert(header.magic == OCC_CKPT_MAGIC);
+        assert(header.num_tables == num_tables);
+
+        /*
+         * Carve every partition's records off the free lists up front, the
+         * free lists aren't safe to share between loaders.
+         */
+        num_partitions = num_tables*OCC_CKPT_PARTITIONS;
+        partitions = (occ_ckpt_partition*)malloc(sizeof(occ_ckpt_partition)*
+                                                 num_partitions);
+        assert(partitions != NULL);
+        for (i = 0; i < num_tables; ++i) {
+                desc = &header.tables[i];
+                assert(desc->num_buckets == tables[i]->NumBuckets());
+                assert(desc->value_sz == tables[i]->RecordSize());
+                for (j = 0; j < OCC_CKPT_PARTITIONS; ++j) {
+                        partitions[i*OCC_CKPT_PARTITIONS+j] = {
+                                tables[i],
+                                desc->offsets[j],
+                                desc->counts[j],
+                                desc->value_sz,
+                                tables[i]->TakeFreeRecords(desc->counts[j]),
+                        };
+                }
+        }
+
+        loaders = (OCCCheckpointLoader**)malloc(sizeof(OCCCheckpointLoader*)*
+                                                num_threads);
+        assert(loaders != NULL);
+        for (i = 0; i < num_threads; ++i) {
+                OCCCheckpointLoaderConfig conf = {
+                        (int)i,
+                        fd,
+                        partitions,
+                        num_partitions,
+                        i,
+                        num_threads,
+                };
+                loaders[i] = new ((int)i) OCCCheckpointLoader(conf);
+                loaders[i]->Run();
+        }
+        for (i = 0; i < num_threads; ++i)
+                loaders[i]->Join();
+        for (i = 0; i < num_tables; ++i)
+                tables[i]->SetInit();
+        close(fd);
+        free(loaders);
+        free(partitions);
+        return header.begin_epoch;
+}
@@ -0,0 +1,125 @@
+#include <occ_logger.h>
+#include <util.h>
+#include <unistd.h>
+#include <cstring>
+
+OCCLogger::OCCLogger(OCCLoggerConfig config) : Runnable(config.cpu)
+{
+        this->config = config;
+        this->durable = 0;
+        this->dirty = false;
+}
+
+void OCCLogger::Init()
+{
+}
+
+/*
+ * Set up a worker's queues, and fill its free queue with OCC_LOG_BUFFERS
+ * buffers which split log_size between them.
+ */
+occ_log_channel* OCCLogger::CreateChannel(uint64_t log_size, int cpu)
+{
+        occ_log_channel *ret;
+        occ_log_buffer buf;
+        char *data;
+        uint32_t i;
+
+        assert(!(OCC_LOG_BUFFERS & (OCC_LOG_BUFFERS-1)));
+        ret = (occ_log_channel*)alloc_mem(sizeof(occ_log_channel), cpu);
+        data = (char*)alloc_mem(2*CACHE_LINE*OCC_LOG_BUFFERS, cpu);
+        ret->full = new SimpleQueue<occ_log_buffer>(data, OCC_LOG_BUFFERS);
+        ret->free = new SimpleQueue<occ_log_buffer>(
+                        &data[CACHE_LINE*OCC_LOG_BUFFERS], OCC_LOG_BUFFERS);
+        ret->epoch = 0;
+
+        buf.size = 0;
+        buf.capacity = log_size / OCC_LOG_BUFFERS;
+        buf.epoch = 0;
+        for (i = 0; i < OCC_LOG_BUFFERS; ++i) {
+                buf.data = (char*)alloc_mem(buf.capacity, cpu);
+                assert(buf.data != NULL);
+                ret->free->EnqueueBlocking(buf);
+        }
+        return ret;
+}
+
+uint32_t OCCLogger::MinEpoch()
+{
+        uint32_t i, epoch, ret;
+
+        ret = ~((uint32_t)0);
+        for (i = 0; i < config.num_channels; ++i) {
+                barrier();
+                epoch = config.channels[i]->epoch;
+                barrier();
+                if (epoch < ret)
+                        ret = epoch;
+        }
+        return ret;
+}
+
+/*
+ * Write out every buffer the workers have handed over, and give it back.
+ * Returns true if anything was written.
+ */
+bool OCCLogger::Drain()
+{
+        occ_log_buffer buf;
+        uint64_t written;
+        ssize_t ret;
+        uint32_t i;
+        bool wrote;
+
+        wrote = false;
+        for (i = 0; i < config.num_channels; ++i) {
+                while (config.channels[i]->full->Dequeue(&buf)) {
+                        for (written = 0; written < buf.size; written += ret) {
+                                ret = write(config.fd, &buf.data[written],
+                                            buf.size - written);
+                                assert(ret > 0);
+                        }
+                        buf.size = 0;
+                        config.channels[i]->free->EnqueueBlocking(buf);
+                        wrote = true;
+                }
+        }
+        return wrote;
+}
+
+/*
+ * Write out the buffers handed over so far, and make the epoch before the 
+ * slowest worker's durable. Returns true if the durable epoch moved.
+ */
+bool OCCLogger::Sync()
+{
+        uint32_t min_epoch;
+        int err;
+
+        /*
+         * Read the workers' epochs first. Their buffers from earlier epochs
+         * are already queued, so the drain below gets them.
+         */
+        min_epoch = MinEpoch();
+        dirty |= Drain();
+        if (min_epoch == 0 || min_epoch - 1 <= durable)
+                return false;
+        if (dirty) {
+                err = fdatasync(config.fd);
+                assert(err == 0);
+                dirty = false;
+        }
+        durable = min_epoch - 1;
+        barrier();
+        *config.durable_epoch = durable;
+        barrier();
+        return true;
+}
+
+void OCCLogger::StartWorking()
+{
+        while (true) {
+                if (!Sync())
+                        do_pause();
+        }
+}
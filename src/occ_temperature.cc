@@ -0,0 +1,65 @@
+#include <occ_temperature.h>
+#include <cpuinfo.h>
+#include <util.h>
+#include <city.h>
+#include <cassert>
+#include <cstring>
+
+#define TEMP_EPOCH(counter) ((uint32_t)((counter) >> 32))
+#define TEMP_COUNT(counter) ((uint32_t)((counter) & 0xFFFFFFFF))
+#define CREATE_TEMP(epoch, count) ((((uint64_t)epoch)<<32) | (uint64_t)count)
+
+void* OCCTemperature::operator new(std::size_t sz, int cpu)
+{
+        return alloc_mem(sz, cpu);
+}
+
+OCCTemperature::OCCTemperature(uint32_t threshold)
+{
+        uint64_t sz;
+
+        assert(threshold > 0);
+        this->threshold = threshold;
+        sz = sizeof(uint64_t) << OCC_TEMP_LOG_SIZE;
+        counters = (volatile uint64_t*)alloc_interleaved_all(sz);
+        assert(counters != NULL);
+        memset((void*)counters, 0x0, sz);
+}
+
+uint64_t OCCTemperature::Index(uint32_t table_id, uint64_t key)
+{
+        return Hash128to64(std::make_pair((uint64_t)table_id, key)) &
+                ((((uint64_t)1) << OCC_TEMP_LOG_SIZE) - 1);
+}
+
+void OCCTemperature::Heat(uint32_t epoch, uint32_t table_id, uint64_t key)
+{
+        volatile uint64_t *counter;
+        uint64_t cur;
+        uint32_t count;
+
+        counter = &counters[Index(table_id, key)];
+        barrier();
+        cur = *counter;
+        barrier();
+        if (TEMP_EPOCH(cur) + OCC_TEMP_WINDOW < epoch)
+                count = 1;
+        else if (TEMP_COUNT(cur) < threshold)
+                count = TEMP_COUNT(cur) + 1;
+        else
+                count = threshold;
+        if (epoch < TEMP_EPOCH(cur))
+                epoch = TEMP_EPOCH(cur);
+        *counter = CREATE_TEMP(epoch, count);
+}
+
+bool OCCTemperature::IsHot(uint32_t epoch, uint32_t table_id, uint64_t key)
+{
+        uint64_t cur;
+
+        barrier();
+        cur = counters[Index(table_id, key)];
+        barrier();
+        return TEMP_COUNT(cur) >= threshold &&
+                TEMP_EPOCH(cur) + OCC_TEMP_WINDOW >= epoch;
+}
@@ -0,0 +1,106 @@
+#include <occ_write_filter.h>
+#include <cpuinfo.h>
+#include <util.h>
+#include <city.h>
+#include <cassert>
+#include <cstring>
+
+void* OCCWriteFilter::operator new(std::size_t sz, int cpu)
+{
+        return alloc_mem(sz, cpu);
+}
+
+OCCWriteFilter::OCCWriteFilter(uint32_t log_bits)
+{
+        uint32_t i;
+
+        assert(log_bits >= 6 && log_bits < 64);
+        assert(!(OCC_FILTER_EPOCHS & (OCC_FILTER_EPOCHS-1)));
+        num_bits = ((uint64_t)1) << log_bits;
+        for (i = 0; i < OCC_FILTER_EPOCHS; ++i) {
+                filters[i].bits =
+                        (volatile uint64_t*)alloc_interleaved_all(num_bits/8);
+                assert(filters[i].bits != NULL);
+                filters[i].epoch = OCC_FILTER_INVALID_EPOCH;
+        }
+
+        /* Epochs start at 0, and advancing to 1 prepares 2. */
+        Prepare(0);
+        Prepare(1);
+}
+
+uint64_t OCCWriteFilter::Hash(uint32_t table_id, uint64_t key)
+{
+        return Hash128to64(std::make_pair((uint64_t)table_id, key));
+}
+
+void OCCWriteFilter::Prepare(uint32_t epoch)
+{
+        occ_epoch_filter *filter;
+
+        filter = GetFilter(epoch);
+        barrier();
+        filter->epoch = OCC_FILTER_INVALID_EPOCH;
+        barrier();
+        memset((void*)filter->bits, 0x0, num_bits/8);
+        barrier();
+        filter->epoch = epoch;
+        barrier();
+}
+
+/*
+ * Sets two bits, one from each half of the key's hash. Bits which are already
+ * set aren't written, to keep the filter's lines shared between workers.
+ */
+void OCCWriteFilter::Insert(uint32_t epoch, uint32_t table_id, uint64_t key)
+{
+        occ_epoch_filter *filter;
+        uint64_t hash, bit, i;
+
+        filter = GetFilter(epoch);
+        barrier();
+        if (filter->epoch != epoch)
+                return;
+        barrier();
+        hash = Hash(table_id, key);
+        for (i = 0; i < 2; ++i, hash >>= 32) {
+                bit = (hash & 0xFFFFFFFF) & (num_bits - 1);
+                if (!(filter->bits[bit/64] & (((uint64_t)1) << (bit % 64))))
+                        atomic_or(&filter->bits[bit/64],
+                                  ((uint64_t)1) << (bit % 64));
+        }
+}
+
+bool OCCWriteFilter::Covers(uint32_t first, uint32_t last)
+{
+        uint32_t epoch;
+
+        if (last < first || last - first >= OCC_FILTER_EPOCHS - 2)
+                return false;
+        for (epoch = first; epoch <= last; ++epoch) {
+                barrier();
+                if (GetFilter(epoch)->epoch != epoch)
+                        return false;
+                barrier();
+        }
+        return true;
+}
+
+bool OCCWriteFilter::MayContain(uint32_t first, uint32_t last,
+                                uint32_t table_id, uint64_t key)
+{
+        volatile uint64_t *bits;
+        uint64_t hash, bit0, bit1;
+        uint32_t epoch;
+
+        hash = Hash(table_id, key);
+        bit0 = (hash & 0xFFFFFFFF) & (num_bits - 1);
+        bit1 = (hash >> 32) & (num_bits - 1);
+        for (epoch = first; epoch <= last; ++epoch) {
+                bits = GetFilter(epoch)->bits;
+                if ((bits[bit0/64] & (((uint64_t)1) << (bit0 % 64))) &&
+                    (bits[bit1/64] & (((uint64_t)1) << (bit1 % 64))))
+                        return true;
+        }
+        return false;
+}
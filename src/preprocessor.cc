@@ -36,43 +36,67 @@ MVActionHasher:: MVActionHasher(int cpuNumber,
 
 void MVActionHasher::StartWorking() 
 {
-        uint32_t epoch = 0;
         while (true) {
     
                 /* Take a single batch as input. */
                 ActionBatch batch = inputQueue->DequeueBlocking();
-    
-                /* Process every action in the batch. */
-                uint32_t numActions = batch.numActions;
-                for (uint32_t i = 0; i < numActions; ++i) {
-                        ProcessAction(batch.actionBuf[i], epoch, i);
-                }
+                batch.threadKeys = SortKeys(batch);
     
                 /* Output the batch to the concurrency control stage. */
                 outputQueue->EnqueueBlocking(batch);
         }
 }
 
-void MVActionHasher::ProcessAction(mv_action *action, uint32_t epoch,
-                                   uint32_t txnCounter) 
+/* 
+ * Count every CC thread's keys, and then fill in each thread's list. The lists
+ * share a single allocation, which the leader CC thread frees once every CC 
+ * thread is done with the batch.
+ */
+MVKeyRefList* MVActionHasher::SortKeys(const ActionBatch &batch)
 {
-        action->__combinedHash =  0;
-        action->__version = (((uint64_t)epoch << 32) | txnCounter);
-        size_t numWrites = action->__writeset.size();  
-        for (uint32_t i = 0; i < numWrites; ++i) {
-    
-                /*
-                 * Find which concurrency control thread is in charge of this 
-                 * key. Write out the threadId and change the combinedHash 
-                 * bitmask appropriately.
-                 */
-                action->__writeset[i].threadId = 0;
-                uint32_t threadId = 
-                        CompositeKey::HashKey(&action->__writeset[i]) % 
-                        MVScheduler::NUM_CC_THREADS;
-                action->__writeset[i].threadId = threadId;
-                action->__combinedHash |= (((uint64_t)1)<<threadId);
+        uint32_t num_threads, total, i, j, t;
+        MVKeyRefList *lists;
+        MVKeyRef *ref;
+        mv_action *action;
+
+        num_threads = MVScheduler::NUM_CC_THREADS;
+        lists = (MVKeyRefList*)malloc(sizeof(MVKeyRefList)*num_threads);
+        assert(lists != NULL);
+        for (t = 0; t < num_threads; ++t) 
+                lists[t].count = 0;
+        total = 0;
+        for (i = 0; i < batch.numActions; ++i) {
+                action = batch.actionBuf[i];
+                for (j = 0; j < action->__readset.size(); ++j) 
+                        lists[action->__readset[j].threadId].count += 1;
+                for (j = 0; j < action->__writeset.size(); ++j) 
+                        lists[action->__writeset[j].threadId].count += 1;
+                total += action->__readset.size() + action->__writeset.size();
+        }
+
+        ref = (MVKeyRef*)malloc(sizeof(MVKeyRef)*(total + 1));
+        assert(ref != NULL);
+        for (t = 0; t < num_threads; ++t) {
+                lists[t].refs = ref;
+                ref += lists[t].count;
+                lists[t].count = 0;
+        }
+        for (i = 0; i < batch.numActions; ++i) {
+                action = batch.actionBuf[i];
+                for (j = 0; j < action->__readset.size(); ++j) {
+                        t = action->__readset[j].threadId;
+                        ref = &lists[t].refs[lists[t].count++];
+                        ref->actionIndex = i;
+                        ref->keyIndex = j;
+                }
+                for (j = 0; j < action->__writeset.size(); ++j) {
+                        t = action->__writeset[j].threadId;
+                        ref = &lists[t].refs[lists[t].count++];
+                        ref->actionIndex = i;
+                        ref->keyIndex = j | MV_WRITE_REF;
+                }
         }
+        return lists;
 }
 
 void MVScheduler::Init() 
@@ -86,6 +110,10 @@ MVScheduler::MVScheduler(MVSchedulerConfig config) :
         this->epoch = 0;
         this->txnCounter = 0;
         this->txnMask = ((uint64_t)1<<config.threadId);
+        this->busyCycles = 0;
+        this->lowWatermark = 0;
+        this->numVersions = 0;
+        memset(this->chainLengths, 0x0, sizeof(this->chainLengths));
 
         this->partitions = 
                 (MVTablePartition**)alloc_mem(sizeof(MVTablePartition*)*config.numTables, 
@@ -96,13 +124,15 @@ MVScheduler::MVScheduler(MVSchedulerConfig config) :
         this->alloc = new (config.cpuNumber) MVRecordAllocator(config.allocatorSize, 
                                                                config.cpuNumber,
                                                                config.worker_start,
-                                                               config.worker_end);
+                                                               config.worker_end,
+                                                               config.recordCpu);
         for (uint32_t i = 0; i < this->config.numTables; ++i) {
 
                 /* Track the partition locally and add it to the database's catalog. */
                 this->partitions[i] =
                         new (config.cpuNumber) MVTablePartition(config.tblPartitionSizes[i],
-                                                                config.cpuNumber, alloc);
+                                                                config.cpuNumber, alloc,
+                                                                config.indexType);
                 assert(this->partitions[i] != NULL);
         }
         this->threadId = config.threadId;
@@ -115,14 +145,43 @@ static inline uint64_t compute_version(uint32_t epoch, uint32_t txnCounter) {
 void MVScheduler::StartWorking() 
 {
         //  std::cout << config.numRecycleQueues << "\n";
+        uint64_t start;
         while (true) {
                 ActionBatch curBatch = config.inputQueue->DequeueBlocking();
+                start = rdtsc();
+                curBatch.startTime = start;
+                ReadLowWatermark();
                 for (uint32_t i = 0; i < config.numSubords; ++i) 
                         config.pubQueues[i]->EnqueueBlocking(curBatch);
-                for (uint32_t i = 0; i < curBatch.numActions; ++i) 
-                        ScheduleTransaction(curBatch.actionBuf[i]);
+                if (curBatch.threadKeys != NULL) {
+                        ScheduleKeys(curBatch);
+                } else {
+                        for (uint32_t i = 0; i < curBatch.numActions; ++i) 
+                                ScheduleTransaction(curBatch.actionBuf[i]);
+                }
                 for (uint32_t i = 0; i < config.numSubords; ++i) 
                         config.subQueues[i]->DequeueBlocking();
+
+                /* 
+                 * Stamp the batch's start on its actions, executors measure
+                 * each action's latency from its own batch's start.
+                 */
+                if (threadId == 0) {
+                        for (uint32_t i = 0; i < curBatch.numActions; ++i)
+                                curBatch.actionBuf[i]->start_time = start;
+                        for (uint32_t i = 0; i < curBatch.numReadOnly; ++i)
+                                curBatch.readOnlyBuf[i]->start_time = start;
+                }
+
+                /* Every CC thread is done with the batch's key lists. */
+                if (threadId == 0 && curBatch.threadKeys != NULL) {
+                        free(curBatch.threadKeys[0].refs);
+                        free(curBatch.threadKeys);
+                        curBatch.threadKeys = NULL;
+                }
+                barrier();
+                busyCycles += rdtsc() - start;
+                barrier();
                 for (uint32_t i = 0; i < config.numOutputs; ++i) 
                         config.outputQueues[i].EnqueueBlocking(curBatch);
                 Recycle();
@@ -139,6 +198,57 @@ void MVScheduler::Recycle()
                         this->alloc->ReturnMVRecords(recycled);
                 }
         }  
+
+        /* 
+         * Versions are only recycled once the low watermark passes their 
+         * successors' epoch. Catch up with it, so that TrimChain never 
+         * follows a pointer to a recycled version. 
+         */
+        ReadLowWatermark();
+}
+
+void MVScheduler::ReadLowWatermark()
+{
+        if (config.lowWaterMarkPtr != NULL) {
+                barrier();
+                lowWatermark = *config.lowWaterMarkPtr;
+                barrier();
+        }
+}
+
+/*
+ * Trim a newly inserted version's chain. Only the newest version no newer than
+ * the low watermark may still be read, through a newer version's recordLink or
+ * epoch_ancestor, so the chain is cut below it. That version is found by 
+ * hopping across epochs through epoch_ancestor, which takes as many hops as 
+ * there are epochs in flight, regardless of the length of the chain.
+ */
+void MVScheduler::TrimChain(MVRecord *version)
+{
+        MVRecord *cur;
+        uint64_t bound;
+        uint32_t length, bucket;
+
+        /* Versions created at or after bound are newer than the watermark. */
+        bound = CREATE_MV_TIMESTAMP(lowWatermark + 1, 0);
+        cur = version->recordLink;
+        while (cur != NULL && cur->createTimestamp >= bound)
+                cur = cur->epoch_ancestor;
+        if (cur != NULL && cur->recordLink != NULL) {
+                cur->recordLink = NULL;
+                cur->epoch_ancestor = NULL;
+        }
+
+        numVersions += 1;
+        if (numVersions % MV_CHAIN_SAMPLE != 0)
+                return;
+        length = 0;
+        for (cur = version; cur != NULL; cur = cur->recordLink) 
+                length += 1;
+        bucket = 0;
+        while (bucket < MV_CHAIN_BUCKETS - 1 && (2U << bucket) <= length)
+                bucket += 1;
+        chainLengths[bucket] += 1;
 }
 
 
@@ -159,9 +269,18 @@ uint32_t MVScheduler::GetCCThread(CompositeKey key)
  * the value for the record will be produced by this transaction. We don't need
  * to track the version of each record written by the transaction. The version
  * is equal to the transaction's timestamp.
+ *
+ * Keys are looked up in groups of MV_LOOKUP_BATCH. Every key of a group is 
+ * hashed and its slot prefetched before any key is resolved, so that the 
+ * misses of a transaction's keys overlap instead of serializing. Reads are 
+ * gathered before writes, and are therefore always resolved first.
  */
 void MVScheduler::ProcessWriteset(mv_action *action)
 {
+        CompositeKey *keys[MV_LOOKUP_BATCH];
+        MVTablePartition *parts[MV_LOOKUP_BATCH];
+        uint64_t slots[MV_LOOKUP_BATCH];
+        uint32_t i, n, num_reads;
 
         while (alloc->Warning()) {
                 //          std::cerr << "[WARNING] CC thread low on versions\n";
@@ -170,20 +289,35 @@ void MVScheduler::ProcessWriteset(mv_action *action)
 
         int r_index = action->__read_starts[threadId];
         int w_index = action->__write_starts[threadId];
-        int i;
-        while (r_index != -1) {
-                i = r_index;
-                MVRecord *ref = this->partitions[action->__readset[i].tableId]->
-                        GetMVRecord(action->__readset[i], action->__version);
-                action->__readset[i].value = ref;
-                r_index = action->__readset[i].next;
-        }
+        while (r_index != -1 || w_index != -1) {
+                n = 0;
+                while (r_index != -1 && n < MV_LOOKUP_BATCH) {
+                        keys[n] = &action->__readset[r_index];
+                        r_index = keys[n]->next;
+                        n += 1;
+                }
+                num_reads = n;
+                while (w_index != -1 && n < MV_LOOKUP_BATCH) {
+                        keys[n] = &action->__writeset[w_index];
+                        w_index = keys[n]->next;
+                        n += 1;
+                }
 
-        while (w_index != -1) {
-                i = w_index;
-                this->partitions[action->__writeset[i].tableId]->
-                        WriteNewVersion(action->__writeset[i], action, action->__version);
-                w_index = action->__writeset[i].next;
+                for (i = 0; i < n; ++i) {
+                        parts[i] = this->partitions[keys[i]->tableId];
+                        slots[i] = parts[i]->GetSlot(*keys[i]);
+                }
+                for (i = 0; i < n; ++i) 
+                        parts[i]->PrefetchVersion(*keys[i], slots[i]);
+                for (i = 0; i < num_reads; ++i) 
+                        keys[i]->value = parts[i]->GetMVRecord(*keys[i],
+                                                               action->__version,
+                                                               slots[i]);
+                for (; i < n; ++i) {
+                        parts[i]->WriteNewVersion(*keys[i], action,
+                                                  action->__version, slots[i]);
+                        TrimChain(keys[i]->value);
+                }
         }
 }
 
@@ -194,3 +328,55 @@ inline void MVScheduler::ScheduleTransaction(mv_action *action)
                 ProcessWriteset(action);
         }
 }
+
+/*
+ * Schedule the keys of a batch sorted by an MVActionHasher. Only this thread's
+ * keys are visited, in the same order as ProcessWriteset, and in groups of 
+ * MV_LOOKUP_BATCH keys so that their misses overlap.
+ */
+void MVScheduler::ScheduleKeys(const ActionBatch &batch)
+{
+        CompositeKey *keys[MV_LOOKUP_BATCH];
+        mv_action *actions[MV_LOOKUP_BATCH];
+        MVTablePartition *parts[MV_LOOKUP_BATCH];
+        uint64_t slots[MV_LOOKUP_BATCH];
+        MVKeyRefList *list;
+        MVKeyRef *ref;
+        uint32_t i, j, n, index;
+
+        list = &batch.threadKeys[threadId];
+        for (i = 0; i < list->count; i += n) {
+                while (alloc->Warning()) 
+                        Recycle();
+                
+                n = list->count - i;
+                if (n > MV_LOOKUP_BATCH)
+                        n = MV_LOOKUP_BATCH;
+                for (j = 0; j < n; ++j) {
+                        ref = &list->refs[i+j];
+                        actions[j] = batch.actionBuf[ref->actionIndex];
+                        index = ref->keyIndex & ~MV_WRITE_REF;
+                        if (ref->keyIndex & MV_WRITE_REF)
+                                keys[j] = &actions[j]->__writeset[index];
+                        else
+                                keys[j] = &actions[j]->__readset[index];
+                        parts[j] = this->partitions[keys[j]->tableId];
+                        slots[j] = parts[j]->GetSlot(*keys[j]);
+                }
+                for (j = 0; j < n; ++j) 
+                        parts[j]->PrefetchVersion(*keys[j], slots[j]);
+                for (j = 0; j < n; ++j) {
+                        ref = &list->refs[i+j];
+                        if (ref->keyIndex & MV_WRITE_REF) {
+                                parts[j]->WriteNewVersion(*keys[j], actions[j],
+                                                          actions[j]->__version,
+                                                          slots[j]);
+                                TrimChain(keys[j]->value);
+                        } else
+                                keys[j]->value = 
+                                        parts[j]->GetMVRecord(*keys[j],
+                                                              actions[j]->__version,
+                                                              slots[j]);
+                }
+        }
+}
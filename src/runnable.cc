@@ -15,8 +15,9 @@ void Runnable::rand_init()
         memset(m_rand_state, 0x0, sizeof(struct random_data));
         random_buf = (char*)malloc(PRNG_BUFSZ);
         memset(random_buf, 0x0, PRNG_BUFSZ);
+
+        /* The generator's state lives in random_buf, don't free it. */
         initstate_r(random(), random_buf, PRNG_BUFSZ, m_rand_state);
-        free(random_buf);
 }
 
 Runnable::Runnable(int cpu_number) {
@@ -144,6 +144,7 @@ bool ycsb_rmw::Run()
                 field_ptr = (char*)get_read_ref(reads[i], 0);
                 for (j = 0; j < 10; ++j)
                         counter += *((uint64_t*)&field_ptr[j*100]);
+                release_ref(reads[i], 0);
         }
 
         /* Perform an RMW operation on each element of the writeset. */
@@ -151,6 +152,7 @@ bool ycsb_rmw::Run()
                 write_ptr = (char*)get_write_ref(writes[i], 0);
                 for (j = 0; j < 10; ++j)
                         *((uint64_t*)&write_ptr[j*100]) += j+1+counter;
+                release_ref(writes[i], 0);
         }
         return true;
 }
@@ -28,7 +28,27 @@ static struct option long_options[] = {
   {"read_pct", required_argument, NULL, 14},
   {"read_txn_size", required_argument, NULL, 15},
   {"hot_position", required_argument, NULL, 16},  
-  {NULL, no_argument, NULL, 17},
+  {"mv_index", required_argument, NULL, 17},
+  {"work_stealing", required_argument, NULL, 18},
+  {"epoch_latency", required_argument, NULL, 19},
+  {"mv_presort", required_argument, NULL, 20},
+  {"mv_numa", required_argument, NULL, 21},
+  {"mv_snapshot", required_argument, NULL, 22},
+  {"mv_stream_rate", required_argument, NULL, 23},
+  {"mv_park", required_argument, NULL, 24},
+  {"lock_headers", required_argument, NULL, 25},
+  {"lock_policy", required_argument, NULL, 26},
+  {"lock_mcs", required_argument, NULL, 27},
+  {"lock_early_release", required_argument, NULL, 28},
+  {"occ_log", required_argument, NULL, 29},
+  {"occ_checkpoint", required_argument, NULL, 30},
+  {"occ_restore", required_argument, NULL, 31},
+  {"occ_inline_table", required_argument, NULL, 32},
+  {"occ_epoch_us", required_argument, NULL, 33},
+  {"occ_filter_bits", required_argument, NULL, 34},
+  {"occ_hot_threshold", required_argument, NULL, 35},
+  {"occ_backoff", required_argument, NULL, 36},
+  {NULL, no_argument, NULL, 37},
 };
 
 enum distribution_t {
@@ -69,6 +89,14 @@ struct OCCConfig {
         uint64_t occ_epoch;
         int read_pct;
         int read_txn_size;
+        char *log_file;
+        char *checkpoint_file;
+        char *restore_file;
+        bool inline_table;
+        uint32_t epoch_us;
+        uint32_t filter_bits;
+        uint32_t hot_threshold;
+        uint64_t backoff;
 };
 
 struct hek_config {
@@ -100,6 +128,10 @@ struct locking_config {
         double theta;
         int read_pct;
         int read_txn_size;
+        bool key_headers;
+        uint32_t lock_policy;
+        bool mcs_latch;
+        bool early_release;
 };
 
 struct MVConfig {
@@ -115,7 +147,14 @@ struct MVConfig {
   double theta;
         int read_pct;
         int read_txn_size;
-        
+        uint32_t index_type;
+        bool work_stealing;
+        uint32_t epoch_latency;
+        bool presort;
+        bool numa;
+        bool snapshot;
+        uint32_t stream_rate;
+        bool park;
 };
 
 class ExperimentConfig {
@@ -138,6 +177,26 @@ class ExperimentConfig {
     READ_PCT,
     READ_TXN_SIZE,
     HOT_POSITION,
+    MV_INDEX,
+    WORK_STEALING,
+    EPOCH_LATENCY,
+    MV_PRESORT,
+    MV_NUMA,
+    MV_SNAPSHOT,
+    MV_STREAM_RATE,
+    MV_PARK,
+    LOCK_HEADERS,
+    LOCK_POLICY,
+    LOCK_MCS,
+    LOCK_EARLY_RELEASE,
+    OCC_LOG,
+    OCC_CHECKPOINT,
+    OCC_RESTORE,
+    OCC_INLINE_TABLE,
+    OCC_EPOCH_US,
+    OCC_FILTER_BITS,
+    OCC_HOT_THRESHOLD,
+    OCC_BACKOFF,
   };
   unordered_map<int, char*> argMap;
 
@@ -215,6 +274,67 @@ class ExperimentConfig {
       if (argMap.count(THETA) > 0) {
         mvConfig.theta = (double)atof(argMap[THETA]);
       }
+
+      /* Optional. Defaults to the chained partition index. */
+      mvConfig.index_type = 0;
+      if (argMap.count(MV_INDEX) > 0) {
+        mvConfig.index_type = (uint32_t)atoi(argMap[MV_INDEX]);
+      }
+      mvConfig.work_stealing = false;
+      if (argMap.count(WORK_STEALING) > 0) {
+        mvConfig.work_stealing = atoi(argMap[WORK_STEALING]) != 0;
+      }
+
+      /* 
+       * Optional. Target batch latency in microseconds. If set, epoch_size 
+       * is only the initial epoch size, and is adapted at runtime.
+       */
+      mvConfig.epoch_latency = 0;
+      if (argMap.count(EPOCH_LATENCY) > 0) {
+        mvConfig.epoch_latency = (uint32_t)atoi(argMap[EPOCH_LATENCY]);
+      }
+
+      /* Optional. Sort each batch's keys by CC thread in a pipeline stage. */
+      mvConfig.presort = false;
+      if (argMap.count(MV_PRESORT) > 0) {
+        mvConfig.presort = atoi(argMap[MV_PRESORT]) != 0;
+      }
+
+      /* 
+       * Optional. Home records on the NUMA node of their CC partition, and 
+       * route actions to executors on that node.
+       */
+      mvConfig.numa = false;
+      if (argMap.count(MV_NUMA) > 0) {
+        mvConfig.numa = atoi(argMap[MV_NUMA]) != 0;
+      }
+
+      /* 
+       * Optional. Run read-only transactions as snapshot reads which bypass 
+       * the CC threads.
+       */
+      mvConfig.snapshot = false;
+      if (argMap.count(MV_SNAPSHOT) > 0) {
+        mvConfig.snapshot = atoi(argMap[MV_SNAPSHOT]) != 0;
+      }
+
+      /* 
+       * Optional. Offered load in txns per second. If non-zero, txns are 
+       * generated while the experiment runs, instead of in advance.
+       */
+      mvConfig.stream_rate = 0;
+      if (argMap.count(MV_STREAM_RATE) > 0) {
+        mvConfig.stream_rate = (uint32_t)atoi(argMap[MV_STREAM_RATE]);
+      }
+
+      /* 
+       * Optional. Threads blocked on a batch queue sleep on a futex after 
+       * spinning for a while, instead of spinning until the queue is ready.
+       */
+      mvConfig.park = false;
+      if (argMap.count(MV_PARK) > 0) {
+        mvConfig.park = atoi(argMap[MV_PARK]) != 0;
+      }
       this->ccType = MULTIVERSION;
     } else if (ccType == LOCKING) {  // ccType == LOCKING
       
@@ -261,6 +381,46 @@ class ExperimentConfig {
         lockConfig.theta = (double)atof(argMap[THETA]);
       }
 
+      /* 
+       * Optional. Keep a lock header per key in the lock table, instead of 
+       * scanning each bucket's list of requests.
+       */
+      lockConfig.key_headers = false;
+      if (argMap.count(LOCK_HEADERS) > 0) {
+        lockConfig.key_headers = atoi(argMap[LOCK_HEADERS]) != 0;
+      }
+
+      /* 
+       * Optional. What a conflicting lock request does: 0 waits (txns lock 
+       * keys in sorted order), 1 aborts (no-wait), 2 waits only for younger 
+       * txns (wait-die). Aborted txns are retried.
+       */
+      lockConfig.lock_policy = 0;
+      if (argMap.count(LOCK_POLICY) > 0) {
+        lockConfig.lock_policy = (uint32_t)atoi(argMap[LOCK_POLICY]);
+        assert(lockConfig.lock_policy < 3);
+      }
+
+      /* 
+       * Optional. Latch lock table buckets with an MCS queue lock instead of 
+       * a test-and-set spinlock.
+       */
+      lockConfig.mcs_latch = false;
+      if (argMap.count(LOCK_MCS) > 0) {
+        lockConfig.mcs_latch = atoi(argMap[LOCK_MCS]) != 0;
+      }
+
+      /* 
+       * Optional. Release locks on records a txn is done with as soon as it 
+       * holds all of its locks. Needs lock_headers, and lock_policy 0.
+       */
+      lockConfig.early_release = false;
+      if (argMap.count(LOCK_EARLY_RELEASE) > 0) {
+        lockConfig.early_release = atoi(argMap[LOCK_EARLY_RELEASE]) != 0;
+        assert(!lockConfig.early_release || 
+               (lockConfig.key_headers && lockConfig.lock_policy == 0));
+      }
+
       this->ccType = LOCKING;
     } else if (ccType == OCC) {
 
@@ -305,6 +465,76 @@ class ExperimentConfig {
         occConfig.theta = (double)atof(argMap[THETA]);
       }
       occConfig.occ_epoch = (uint32_t)atoi(argMap[OCC_EPOCH]);              
+
+      /* 
+       * Optional. Redo log committed writes to this file, and count a txn as 
+       * committed once its epoch is durable.
+       */
+      occConfig.log_file = NULL;
+      if (argMap.count(OCC_LOG) > 0) {
+        occConfig.log_file = argMap[OCC_LOG];
+      }
+
+      /* Optional. Write an image of the tables here after the dry run. */
+      occConfig.checkpoint_file = NULL;
+      if (argMap.count(OCC_CHECKPOINT) > 0) {
+        occConfig.checkpoint_file = argMap[OCC_CHECKPOINT];
+      }
+
+      /* 
+       * Optional. Load the tables from an image written by --occ_checkpoint, 
+       * instead of running the loader txns.
+       */
+      occConfig.restore_file = NULL;
+      if (argMap.count(OCC_RESTORE) > 0) {
+        occConfig.restore_file = argMap[OCC_RESTORE];
+      }
+
+      /* 
+       * Optional. Keep records inline in open-addressed tables, rather than 
+       * in hash chains.
+       */
+      occConfig.inline_table = false;
+      if (argMap.count(OCC_INLINE_TABLE) > 0) {
+        occConfig.inline_table = atoi(argMap[OCC_INLINE_TABLE]) != 0;
+      }
+
+      /* 
+       * Optional. Epoch length in microseconds. If set, workers advance epochs 
+       * between txns, and worker 0 runs txns instead of an epoch loop.
+       */
+      occConfig.epoch_us = 0;
+      if (argMap.count(OCC_EPOCH_US) > 0) {
+        occConfig.epoch_us = (uint32_t)atoi(argMap[OCC_EPOCH_US]);
+      }
+
+      /* 
+       * Optional. Log2 of the bits in each epoch's write filter. If set, 
+       * large read sets only re-validate keys the filters say may have been 
+       * written since the txn started.
+       */
+      occConfig.filter_bits = 0;
+      if (argMap.count(OCC_FILTER_BITS) > 0) {
+        occConfig.filter_bits = (uint32_t)atoi(argMap[OCC_FILTER_BITS]);
+      }
+
+      /* 
+       * Optional. Lock records at first access once they've caused this many 
+       * aborts within a few epochs.
+       */
+      occConfig.hot_threshold = 0;
+      if (argMap.count(OCC_HOT_THRESHOLD) > 0) {
+        occConfig.hot_threshold = (uint32_t)atoi(argMap[OCC_HOT_THRESHOLD]);
+      }
+
+      /* 
+       * Optional. Cycles to back off before retrying an aborted txn, doubled 
+       * on each further abort.
+       */
+      occConfig.backoff = 0;
+      if (argMap.count(OCC_BACKOFF) > 0) {
+        occConfig.backoff = (uint64_t)atoll(argMap[OCC_BACKOFF]);
+      }
       this->ccType = OCC;
     } else if (ccType == HEK) {
 
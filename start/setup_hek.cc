@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <small_bank.h>
 #include <setup_workload.h>
+#include <latency_histogram.h>
 
 /* Total space available for free lists */
 #define TOTAL_SIZE (((uint64_t)1) << 35)
@@ -17,6 +18,7 @@
 struct hek_result {
         struct timespec elapsed_time;
         uint32_t num_txns;
+        LatencyHistogram latencies;
 };
 
 /* 
@@ -124,17 +126,30 @@ static hek_table** setup_tables(hek_config config)
 
 
 /*
- * Create hek_queues for inter-thread communication of commit dependency 
- * results.
+ * Create a queue per worker for inter-thread communication of commit 
+ * dependency results. Every worker enqueues into every other worker's queue, 
+ * so each queue gets the capacity of a queue per producer.
  */
-static SimpleQueue<hek_action*>*** setup_hek_queues(hek_config config)
+static MPMCQueue<hek_action*>** setup_hek_queues(hek_config config)
 {
-        SimpleQueue<hek_action*> ***ret =
-                (SimpleQueue<hek_action*>***)
-                malloc(sizeof(SimpleQueue<hek_action**>)*config.num_threads);
+        MPMCQueue<hek_action*> **ret;
+        uint64_t size;
+        char *data;
         int i;
-        for (i = 0; i < config.num_threads; ++i) 
-                ret[i] = setup_queues<hek_action*>(config.num_threads, 1024);
+
+        size = 1;
+        while (size < 1024*(uint64_t)config.num_threads)
+                size <<= 1;
+        ret = (MPMCQueue<hek_action*>**)
+                malloc(sizeof(MPMCQueue<hek_action*>*)*config.num_threads);
+        assert(ret != NULL);
+        for (i = 0; i < config.num_threads; ++i) {
+                data = (char*)alloc_mem(size*
+                                        MPMCQueue<hek_action*>::SlotSize(true),
+                                        i);
+                assert(data != NULL);
+                ret[i] = new MPMCQueue<hek_action*>(data, size, true);
+        }
         return ret;
 }
 
@@ -194,7 +209,7 @@ static hek_worker** setup_workers(hek_config config, hek_table **tables,
                                   SimpleQueue<hek_batch> ***output_queues)
 {
         SimpleQueue<hek_batch> **inputs, **outputs;
-        SimpleQueue<hek_action*> ***commit_queues, ***abort_queues;        
+        MPMCQueue<hek_action*> **commit_queues, **abort_queues;
         hek_worker **workers;
         hek_worker_config worker_conf;
         int i;
@@ -226,8 +241,8 @@ static hek_worker** setup_workers(hek_config config, hek_table **tables,
                 worker_conf.cpu = i;
                 worker_conf.input_queue = inputs[i];
                 worker_conf.output_queue = outputs[i];
-                worker_conf.commit_queues = commit_queues[i];
-                worker_conf.abort_queues = abort_queues[i];
+                worker_conf.commit_queue = commit_queues[i];
+                worker_conf.abort_queue = abort_queues[i];
                 workers[i] = new (i) hek_worker(worker_conf);
         }
 
@@ -628,13 +643,15 @@ static struct hek_result run_experiment(hek_config config,
 {
         struct timespec start_time, end_time;
         struct hek_result result;
-        uint32_t num_txns;
+        uint32_t num_txns, i;
         
         init_workers(workers, config.num_threads);
 
         /* Warm up run. */
         start_single_round(input_queues, input[0], config.num_threads);
         end_single_round(output_queues, config.num_threads);
+        for (i = 0; i < config.num_threads; ++i)
+                workers[i]->Latencies()->Reset();
 
         /* Real run. */
         barrier();
@@ -650,6 +667,8 @@ static struct hek_result run_experiment(hek_config config,
         /* Write to result struct.  */
         result.elapsed_time = diff_time(end_time, start_time);
         result.num_txns = num_txns;
+        for (i = 0; i < config.num_threads; ++i)
+                result.latencies.Merge(*workers[i]->Latencies());
         return result;
 }
 
@@ -668,6 +687,7 @@ static void write_results(struct hek_result result, hek_config config)
         result_file << " threads:" << config.num_threads << " hek ";
         result_file << "records:" << config.num_records << " ";
         result_file << "read_pct:" << config.read_pct << " ";
+        result.latencies.WritePercentiles(result_file);
         if (config.experiment == 0) 
                 result_file << "10rmw" << " ";
         else if (config.experiment == 1)
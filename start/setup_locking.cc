@@ -9,6 +9,7 @@
 #include <fstream>
 #include <sys/time.h>
 #include <common_constants.h>
+#include <latency_histogram.h>
 
 #define EXTRA_BATCHES 1
 
@@ -18,6 +19,8 @@ struct locking_result {
         double time;
         timespec elapsed_time;
         uint64_t num_txns;
+        uint64_t num_aborts;
+        LatencyHistogram latencies;
 };
 
 static inline double GetTime() {
@@ -192,6 +195,17 @@ static void write_locking_output(locking_config conf,
         result_file << "records:" << conf.num_records << " ";
         result_file << "read_pct:" << conf.read_pct << " ";
         result_file << "txn_size:" << w_conf.txn_size << " ";
+        result.latencies.WritePercentiles(result_file);
+        if (conf.key_headers == true)
+                result_file << "lock_headers ";
+        if (conf.mcs_latch == true)
+                result_file << "mcs_latch ";
+        if (conf.early_release == true)
+                result_file << "early_release ";
+        if (conf.lock_policy == LOCK_NO_WAIT)
+                result_file << "no_wait aborts:" << result.num_aborts << " ";
+        else if (conf.lock_policy == LOCK_WAIT_DIE)
+                result_file << "wait_die aborts:" << result.num_aborts << " ";
         if (conf.experiment == 2)
                 result_file << "hot_position:" << w_conf.hot_position << " ";
 
@@ -232,6 +246,7 @@ static struct locking_result do_measurement(locking_config conf,
         uint32_t i, j;
         struct locking_result result;
         timespec start_time, end_time;
+        uint64_t dry_aborts;
 
         pin_thread(79);
         
@@ -258,6 +273,13 @@ static struct locking_result do_measurement(locking_config conf,
         }
 
         std::cerr << "Done with dry run!\n";
+
+        /* Workers are idle until the next batch, discard dry run latencies. */
+        dry_aborts = 0;
+        for (i = 0; i < conf.num_threads; ++i) {
+                workers[i]->Latencies()->Reset();
+                dry_aborts += workers[i]->NumAborts();
+        }
         
         double start_dbl = GetTime();
         barrier();
@@ -275,6 +297,12 @@ static struct locking_result do_measurement(locking_config conf,
         barrier();
         result.time = end_dbl - start_dbl;
         result.elapsed_time = diff_time(end_time, start_time);
+        result.num_aborts = 0;
+        for (i = 0; i < conf.num_threads; ++i) {
+                result.latencies.Merge(*workers[i]->Latencies());
+                result.num_aborts += workers[i]->NumAborts();
+        }
+        result.num_aborts -= dry_aborts;
         return result;
 }
 
@@ -311,6 +339,10 @@ void locking_experiment(locking_config conf, workload_config w_conf)
                 num_records,
                 0,
                 (int)conf.num_threads - 1,
+                conf.key_headers,
+                (lock_policy)conf.lock_policy,
+                conf.mcs_latch,
+                conf.early_release,
         };
         tables = setup_hash_tables(num_tables, num_records, false);
         lock_manager = new LockManager(mgr_config);        
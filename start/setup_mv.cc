@@ -8,6 +8,7 @@
 #include <fstream>
 #include <setup_workload.h>
 #include <common_constants.h>
+#include <latency_histogram.h>
 
 #define INPUT_SIZE 2048
 #define OFFSET 0
@@ -15,7 +16,64 @@
 
 #define MV_DRY_RUNS 5
 
+/* 
+ * Adaptive epoch sizing (--epoch_latency). The driver keeps at most 
+ * ADAPT_WINDOW batches in flight, and re-sizes epochs every ADAPT_PERIOD 
+ * completed batches. Epoch sizes stay within [epoch_size/ADAPT_RANGE, 
+ * epoch_size*ADAPT_RANGE] of the initial epoch size.
+ */
+#define ADAPT_WINDOW 8
+#define ADAPT_PERIOD 4
+#define ADAPT_RANGE 16
+#define ADAPT_IDLE_PCT 10
+#define ADAPT_BUSY_PCT 90
+#define ADAPT_SLACK_PCT 50
+
+struct epoch_controller {
+        uint32_t epoch_size;
+        uint32_t min_size;
+        uint32_t max_size;
+        uint64_t target_cycles;
+
+        /* Measurements since the last adjustment. */
+        uint64_t period_start;
+        uint64_t sched_busy;
+        uint64_t exec_idle;
+        uint64_t latency_cycles;
+        uint32_t num_batches;
+
+        /* Totals over the whole experiment. */
+        uint64_t total_batches;
+        uint64_t total_txns;
+        uint64_t total_latency;
+};
+
+/* 
+ * Open-loop streaming input (--mv_stream_rate). Txns arrive at a fixed rate, 
+ * and are generated as they arrive. A batch is closed once it holds 
+ * epoch_size txns, or once its oldest txn has waited STREAM_MAX_DELAY 
+ * microseconds. At most STREAM_WINDOW batches are in flight.
+ */
+#define STREAM_WINDOW 64
+#define STREAM_MAX_DELAY 1000
+
+struct stream_client {
+        uint64_t interval;      /* Cycles between arrivals. */
+        uint32_t num_txns;
+        uint64_t num_batches;
+
+        /* 
+         * Intended arrival time of each txn, and the cycles from their arrival 
+         * until their batch completed. 
+         */
+        uint64_t *arrivals;
+        LatencyHistogram latencies;
+};
+
 static uint64_t dbSize = ((uint64_t)1<<36);
+
+/* Whether blocked threads park on the batch queues, from MVConfig::park. */
+static bool parkQueues = false;
 extern uint32_t GLOBAL_RECORD_SIZE;
 
 Table** mv_tables;
@@ -54,10 +112,12 @@ static void CreateQueues(int cpuNumber, uint32_t subCount,
         for (uint32_t i = 0; i < subCount; ++i) {
                 auto pubQueue = 
                         new (&pubMetaData[i]) 
-                        SimpleQueue<ActionBatch>(&pubArray[2*CACHE_LINE*i], 2);
+                        SimpleQueue<ActionBatch>(&pubArray[2*CACHE_LINE*i], 2,
+                                                 parkQueues);
                 auto subQueue =
                         new (&subMetaData[i])
-                        SimpleQueue<ActionBatch>(&subArray[2*CACHE_LINE*i], 2);
+                        SimpleQueue<ActionBatch>(&subArray[2*CACHE_LINE*i], 2,
+                                                 parkQueues);
                 assert(pubQueue != NULL && subQueue != NULL);
                 pubQueues[i] = pubQueue;
                 subQueues[i] = subQueue;
@@ -79,7 +139,10 @@ static MVSchedulerConfig SetupSched(int cpuNumber,
                                     uint32_t numOutputs,
                                     SimpleQueue<ActionBatch> *outputQueues,
                                     int worker_start,
-                                    int worker_end) {
+                                    int worker_end,
+                                    MVIndexType indexType,
+                                    int *recordCpus,
+                                    volatile uint32_t *lowWaterMarkPtr) {
         assert(inputQueue != NULL && outputQueues != NULL);
         uint32_t subCount;
         SimpleQueue<ActionBatch> **pubQueues, **subQueues;
@@ -148,6 +211,9 @@ static MVSchedulerConfig SetupSched(int cpuNumber,
                 queueArray,
                 worker_start,
                 worker_end,
+                indexType,
+                recordCpus != NULL? recordCpus[threadId] : -1,
+                lowWaterMarkPtr,
         };
         return cfg;
 }
@@ -256,10 +322,47 @@ static ExecutorConfig SetupExec(uint32_t cpuNumber, uint32_t threadId,
     1,
     gcQueues,
     gcConfig,
+    NULL,
+    NULL,
+    0,
+    0,
+    1,
+    NULL,
   };
   return config;
 }
 
+// Setup a work stealing deque for each worker. Each deque is large enough to 
+// hold a worker's share of an epoch.
+static WorkStealingDeque<mv_action*>** SetupDeques(uint32_t cpuStart, 
+                                                   uint32_t numWorkers,
+                                                   uint32_t epochSize) {
+  uint64_t dequeSize = 1;
+  while (dequeSize < epochSize/numWorkers + 1) 
+    dequeSize <<= 1;
+  
+  WorkStealingDeque<mv_action*> **deques = 
+    (WorkStealingDeque<mv_action*>**)malloc(sizeof(WorkStealingDeque<mv_action*>*)*numWorkers);
+  for (uint32_t i = 0; i < numWorkers; ++i) {
+    int cpu = (int)(cpuStart+i);
+    mv_action **data = 
+      (mv_action**)alloc_mem(sizeof(mv_action*)*dequeSize, cpu);
+    void *deque = alloc_mem(sizeof(WorkStealingDeque<mv_action*>), cpu);
+    assert(data != NULL && deque != NULL);
+    deques[i] = new (deque) WorkStealingDeque<mv_action*>(data, dequeSize);
+  }
+  return deques;
+}
+
+// Setup the epoch counter of each worker, followed by the GC low-water mark, 
+// which is the minimum of the workers' epochs.
+static volatile uint32_t* SetupEpochs(uint32_t numWorkers) {
+  volatile uint32_t *epochArray = 
+    (volatile uint32_t*)malloc(sizeof(uint32_t)*(numWorkers+1));  
+  memset((void*)epochArray, 0x0, sizeof(uint32_t)*(numWorkers+1));
+  return epochArray;
+}
+
 static Executor** SetupExecutors(uint32_t cpuStart,
                                  uint32_t numWorkers, 
                                  uint32_t numCCThreads,
@@ -267,16 +370,16 @@ static Executor** SetupExecutors(uint32_t cpuStart,
                                  SimpleQueue<ActionBatch> *inputQueue,
                                  SimpleQueue<ActionBatch> *outputQueue,
                                  uint32_t queuesPerCCThread,
-                                 SimpleQueue<MVRecordList> ***ccQueues) {  
+                                 SimpleQueue<MVRecordList> ***ccQueues,
+                                 WorkStealingDeque<mv_action*> **deques,
+                                 int *partitionNodes,
+                                 MVTable **tables,
+                                 volatile uint32_t *epochArray) {  
   assert(queuesPerCCThread == numWorkers);
   assert(queuesPerTable == numWorkers);
 
   uint64_t threadDbSz = dbSize / numWorkers;
   Executor **execs = (Executor**)malloc(sizeof(Executor*)*numWorkers);
-  volatile uint32_t *epochArray = 
-    (volatile uint32_t*)malloc(sizeof(uint32_t)*(numWorkers+1));  
-  memset((void*)epochArray, 0x0, sizeof(uint32_t)*(numWorkers+1));
-
   uint32_t numTables = 1;
 
   uint64_t *sizeData = (uint64_t*)malloc(sizeof(uint32_t)*2);
@@ -300,6 +403,26 @@ static Executor** SetupExecutors(uint32_t cpuStart,
                            numCCThreads,
                            1,
                            queuesPerTable);
+    configs[i].deques = deques;
+    configs[i].tables = tables;
+  }
+
+  // Number the workers on each NUMA node, actions routed to a node are striped
+  // across the node's workers.
+  if (partitionNodes != NULL) {
+    for (uint32_t i = 0; i < numWorkers; ++i) {
+      configs[i].partitionNodes = partitionNodes;
+      configs[i].node = numa_node_of_cpu((int)(cpuStart+i));
+      configs[i].nodeRank = 0;
+      configs[i].nodeExecutors = 0;
+      for (uint32_t j = 0; j < numWorkers; ++j) {
+        if (numa_node_of_cpu((int)(cpuStart+j)) != configs[i].node)
+          continue;
+        if (j < i)
+          configs[i].nodeRank += 1;
+        configs[i].nodeExecutors += 1;
+      }
+    }
   }
   
   // Second pass, connect recycled data producers with consumers
@@ -340,7 +463,8 @@ static SimpleQueue<T>* SetupQueuesMany(uint32_t numEntries, uint32_t numQueues,
 
   // Initialize queue structs
   for (uint32_t i = 0; i < numQueues; ++i) {
-      new (&queues[i]) SimpleQueue<T>(&queueData[dataDelta*i], numEntries);
+      new (&queues[i]) SimpleQueue<T>(&queueData[dataDelta*i], numEntries,
+                                      parkQueues);
   }
   return queues;
 }
@@ -353,18 +477,30 @@ static MVScheduler** SetupSchedulers(int numProcs,
                                      uint32_t numTables,
                                      size_t tableSize, 
                                      SimpleQueue<MVRecordList> ***gcRefs_OUT,
-                                     int worker_start, int worker_end) {  
+                                     int worker_start, int worker_end,
+                                     MVIndexType indexType,
+                                     int *recordCpus,
+                                     volatile uint32_t *lowWaterMarkPtr) {  
         
-  size_t partitionChunk = tableSize/numProcs;
-  size_t *tblPartitionSizes = (size_t*)malloc(numTables*sizeof(size_t));
+  // Keys are hash partitioned, so partitions don't hold exactly 
+  // tableSize/numProcs keys each. Count every partition's keys, so that no 
+  // bucket index fills up.
+  assert((uint32_t)numProcs == NUM_CC_THREADS);
+  size_t *tblPartitionSizes = 
+    (size_t*)malloc(numProcs*numTables*sizeof(size_t));
+  memset(tblPartitionSizes, 0x0, numProcs*numTables*sizeof(size_t));
   for (uint32_t i = 0; i < numTables; ++i) {
-    tblPartitionSizes[i] = partitionChunk;
+    for (uint64_t j = 0; j < tableSize; ++j) {
+      CompositeKey key(false, i, j);
+      tblPartitionSizes[(CompositeKey::HashKey(&key) % numProcs)*numTables + 
+                        i] += 1;
+    }
   }
 
   // Set up queues for leader thread
   char *inputArray = (char*)alloc_mem(CACHE_LINE*INPUT_SIZE, 0);            
   SimpleQueue<ActionBatch> *leaderInputQueue = 
-    new SimpleQueue<ActionBatch>(inputArray, INPUT_SIZE);
+    new SimpleQueue<ActionBatch>(inputArray, INPUT_SIZE, parkQueues);
 
   SimpleQueue<ActionBatch> *leaderOutputQueues = 
     SetupQueuesMany<ActionBatch>(INPUT_SIZE, (uint32_t)numOutputs, 0);
@@ -380,7 +516,9 @@ static MVScheduler** SetupSchedulers(int numProcs,
                                                     leaderInputQueue,
                                                     numOutputs,
                                                     leaderOutputQueues,
-                                                    worker_start, worker_end);
+                                                    worker_start, worker_end,
+                                                    indexType, recordCpus,
+                                                    lowWaterMarkPtr);
 
   schedArray[0] = 
     new (globalLeaderConfig.cpuNumber) MVScheduler(globalLeaderConfig);
@@ -395,12 +533,13 @@ static MVScheduler** SetupSchedulers(int numProcs,
       auto outputQueue = globalLeaderConfig.subQueues[9+leaderNum-1];
       MVSchedulerConfig config = SetupSched(i, i, numProcs, allocatorSize, 
                                             numTables,
-                                            tblPartitionSizes, 
+                                            &tblPartitionSizes[i*numTables], 
                                             numOutputs,
                                             inputQueue, 
                                             1,
                                             outputQueue, worker_start,
-                                            worker_end);
+                                            worker_end, indexType,
+                                            recordCpus, lowWaterMarkPtr);
       schedArray[i] = new (config.cpuNumber) MVScheduler(config);
       gcRefs_OUT[i] = config.recycleQueues;
       localLeaderConfig = config;
@@ -411,12 +550,13 @@ static MVScheduler** SetupSchedulers(int numProcs,
       auto outputQueue = localLeaderConfig.subQueues[index-1];
       MVSchedulerConfig subConfig = SetupSched(i, i, numProcs, allocatorSize, 
                                                numTables,
-                                               tblPartitionSizes, 
+                                               &tblPartitionSizes[i*numTables], 
                                                numOutputs,
                                                inputQueue, 
                                                1,
                                                outputQueue, worker_start,
-                                               worker_end);
+                                               worker_end, indexType,
+                                               recordCpus, lowWaterMarkPtr);
       schedArray[i] = new (subConfig.cpuNumber) MVScheduler(subConfig);
       gcRefs_OUT[i] = subConfig.recycleQueues;
     }
@@ -530,6 +670,11 @@ static ActionBatch mv_create_action_batch(MVConfig config,
         uint32_t i;
         uint64_t timestamp;
         batch.numActions = config.epochSize;
+        batch.threadKeys = NULL;
+        batch.homeNodes = NULL;
+        batch.readOnlyBuf = NULL;
+        batch.numReadOnly = 0;
+        batch.startTime = 0;
         batch.actionBuf =
                 (mv_action**)malloc(sizeof(mv_action*)*config.epochSize);
         assert(batch.actionBuf != NULL);
@@ -543,8 +688,65 @@ static ActionBatch mv_create_action_batch(MVConfig config,
         return batch;
 }
 
+/* 
+ * Route every action to the home node of its first write, or of its first 
+ * read if it is read-only.
+ */
+static void mv_route_batch(ActionBatch *batch, int *partition_nodes)
+{
+        mv_action *action;
+        uint32_t i, thread;
+
+        batch->homeNodes = (uint8_t*)malloc(batch->numActions);
+        assert(batch->homeNodes != NULL);
+        for (i = 0; i < batch->numActions; ++i) {
+                action = batch->actionBuf[i];
+                assert(action->__writeset.size() + action->__readset.size() > 0);
+                if (action->__writeset.size() > 0)
+                        thread = action->__writeset[0].threadId;
+                else
+                        thread = action->__readset[0].threadId;
+                batch->homeNodes[i] = (uint8_t)partition_nodes[thread];
+        }
+}
+
+/* 
+ * Move a batch's read-only actions behind its writers, where they run as 
+ * snapshot reads of the preceding epoch. The writers keep their order, and 
+ * their home nodes if the batch is routed.
+ */
+static void mv_split_batch(ActionBatch *batch, uint32_t epoch)
+{
+        mv_action *action, **snapshots;
+        uint32_t i, num_writers, num_snapshots;
+
+        snapshots = (mv_action**)malloc(sizeof(mv_action*)*batch->numActions);
+        assert(snapshots != NULL);
+        num_writers = 0;
+        num_snapshots = 0;
+        for (i = 0; i < batch->numActions; ++i) {
+                action = batch->actionBuf[i];
+                if (action->__readonly == true) {
+                        action->__snapshot = true;
+                        action->__version = CREATE_MV_TIMESTAMP(epoch, 0);
+                        snapshots[num_snapshots++] = action;
+                        continue;
+                }
+                if (batch->homeNodes != NULL)
+                        batch->homeNodes[num_writers] = batch->homeNodes[i];
+                batch->actionBuf[num_writers++] = action;
+        }
+        memcpy(&batch->actionBuf[num_writers], snapshots, 
+               sizeof(mv_action*)*num_snapshots);
+        free(snapshots);
+        batch->numActions = num_writers;
+        batch->readOnlyBuf = &batch->actionBuf[num_writers];
+        batch->numReadOnly = num_snapshots;
+}
+
 static void mv_setup_input_array(std::vector<ActionBatch> *input,
-                                 MVConfig mv_config, workload_config w_config)
+                                 MVConfig mv_config, workload_config w_config,
+                                 int *partition_nodes)
 {
         uint32_t num_epochs;
         ActionBatch batch;
@@ -553,11 +755,68 @@ static void mv_setup_input_array(std::vector<ActionBatch> *input,
         num_epochs = 2*get_num_epochs(mv_config);
         for (i = 0; i < num_epochs + MV_DRY_RUNS; ++i) {
                 batch = mv_create_action_batch(mv_config, w_config, i+2);
+                if (mv_config.snapshot == true)
+                        mv_split_batch(&batch, i+2);
+                if (partition_nodes != NULL)
+                        mv_route_batch(&batch, partition_nodes);
                 input->push_back(batch);
         }
         std::cerr << "Done setting up mv input!\n";
 }
 
+/* 
+ * With adaptive epochs, batches are carved out of a single stream of actions 
+ * at runtime. Versions are assigned when a batch is submitted.
+ */
+static void mv_setup_adaptive_input(std::vector<ActionBatch> *dry_runs,
+                                    ActionBatch *stream,
+                                    MVConfig mv_config, 
+                                    workload_config w_config,
+                                    int *partition_nodes)
+{
+        MVConfig stream_config;
+        ActionBatch batch;
+        uint32_t i;
+
+        for (i = 0; i < MV_DRY_RUNS; ++i) {
+                batch = mv_create_action_batch(mv_config, w_config, i+2);
+                if (mv_config.snapshot == true)
+                        mv_split_batch(&batch, i+2);
+                if (partition_nodes != NULL)
+                        mv_route_batch(&batch, partition_nodes);
+                dry_runs->push_back(batch);
+        }
+        stream_config = mv_config;
+        stream_config.epochSize = mv_config.numTxns;
+        *stream = mv_create_action_batch(stream_config, w_config, 0);
+        if (partition_nodes != NULL)
+                mv_route_batch(stream, partition_nodes);
+        std::cerr << "Done setting up mv input!\n";
+}
+
+/* 
+ * With streaming input, only the dry runs are generated in advance. The rest 
+ * of the txns are generated by the driver as they arrive. 
+ */
+static void mv_setup_stream_input(std::vector<ActionBatch> *dry_runs,
+                                  MVConfig mv_config, 
+                                  workload_config w_config,
+                                  int *partition_nodes)
+{
+        ActionBatch batch;
+        uint32_t i;
+
+        for (i = 0; i < MV_DRY_RUNS; ++i) {
+                batch = mv_create_action_batch(mv_config, w_config, i+2);
+                if (mv_config.snapshot == true)
+                        mv_split_batch(&batch, i+2);
+                if (partition_nodes != NULL)
+                        mv_route_batch(&batch, partition_nodes);
+                dry_runs->push_back(batch);
+        }
+        std::cerr << "Done setting up mv input!\n";
+}
+
 static ActionBatch generate_db(workload_config conf)
 {
         txn **loader_txns;
@@ -570,6 +829,11 @@ static ActionBatch generate_db(workload_config conf)
         num_txns = generate_input(conf, &loader_txns);
         assert(loader_txns != NULL);
         ret.numActions = num_txns;
+        ret.threadKeys = NULL;
+        ret.homeNodes = NULL;
+        ret.readOnlyBuf = NULL;
+        ret.numReadOnly = 0;
+        ret.startTime = 0;
         ret.actionBuf = (mv_action**)malloc(sizeof(mv_action*)*num_txns);
         for (i = 0; i < num_txns; ++i) {
                 ret.actionBuf[i] = generate_mv_action(loader_txns[i]);
@@ -579,12 +843,24 @@ static ActionBatch generate_db(workload_config conf)
         return ret;
 }
  
-static void write_results(MVConfig config, timespec elapsed_time)
+static void write_results(MVConfig config, timespec elapsed_time,
+                          struct epoch_controller *ctrl,
+                          struct stream_client *client,
+                          MVScheduler **scheds,
+                          Executor **execs)
 {
-        uint32_t num_epochs;
-        double elapsed_milli;
+        uint64_t num_txns, local_accesses, remote_accesses;
+        uint64_t chain_lengths[MV_CHAIN_BUCKETS];
+        LatencyHistogram latencies;
+        uint32_t i, j;
+        double elapsed_milli, cycles_per_micro;
         std::ofstream result_file;
-        num_epochs = get_num_epochs(config);
+        if (ctrl != NULL)
+                num_txns = ctrl->total_txns;
+        else if (client != NULL)
+                num_txns = client->num_txns;
+        else
+                num_txns = (uint64_t)get_num_epochs(config)*config.epochSize;
         elapsed_milli =
                 1000.0*elapsed_time.tv_sec + elapsed_time.tv_nsec/1000000.0;
         std::cerr << "Number of txns: " << config.numTxns << "\n";
@@ -592,7 +868,51 @@ static void write_results(MVConfig config, timespec elapsed_time)
         result_file.open("results.txt", std::ios::app | std::ios::out);
         result_file << "mv ";
         result_file << "time:" << elapsed_milli << " ";
-        result_file << "txns:" << (num_epochs)*config.epochSize << " ";
+        result_file << "txns:" << num_txns << " ";
+        if (config.numa == true) {
+                local_accesses = 0;
+                remote_accesses = 0;
+                for (i = 0; i < config.numWorkerThreads; ++i) {
+                        local_accesses += execs[i]->LocalAccesses();
+                        remote_accesses += execs[i]->RemoteAccesses();
+                }
+                std::cerr << "Local accesses: " << local_accesses << "\n";
+                std::cerr << "Remote accesses: " << remote_accesses << "\n";
+                result_file << "local_accesses:" << local_accesses << " ";
+                result_file << "remote_accesses:" << remote_accesses << " ";
+        }
+
+        /* Bucket i counts sampled chains of length [2^i, 2^(i+1)). */
+        std::cerr << "Version chain lengths:";
+        result_file << "chains:";
+        for (i = 0; i < MV_CHAIN_BUCKETS; ++i) {
+                chain_lengths[i] = 0;
+                for (j = 0; j < config.numCCThreads; ++j) 
+                        chain_lengths[i] += scheds[j]->ChainLengths(i);
+                std::cerr << " " << chain_lengths[i];
+                result_file << (i == 0? "" : ",") << chain_lengths[i];
+        }
+        std::cerr << "\n";
+        result_file << " ";
+        if (ctrl != NULL) {
+                cycles_per_micro = FREQUENCY / 1000000.0;
+                result_file << "epoch_latency:" << config.epoch_latency << " ";
+                result_file << "final_epoch:" << ctrl->epoch_size << " ";
+                result_file << "mean_epoch:" << 
+                        ctrl->total_txns / ctrl->total_batches << " ";
+                result_file << "mean_latency:" << 
+                        ctrl->total_latency / ctrl->total_batches / 
+                        cycles_per_micro << " ";
+        }
+        if (client != NULL) {
+                result_file << "stream_rate:" << config.stream_rate << " ";
+                result_file << "mean_epoch:" << 
+                        client->num_txns / client->num_batches << " ";
+                client->latencies.WritePercentiles(result_file, "arrival_");
+        }
+        for (i = 0; i < config.numWorkerThreads; ++i)
+                latencies.Merge(*execs[i]->Latencies());
+        latencies.WritePercentiles(result_file);
         result_file << "ccthreads:" << config.numCCThreads << " ";
         result_file << "workerthreads:" << config.numWorkerThreads << " ";
         result_file << "records:" << config.numRecords << " ";
@@ -616,9 +936,23 @@ static void write_results(MVConfig config, timespec elapsed_time)
         
 }
 
+/* 
+ * Discard the latencies of the init batch and dry runs. Executors are idle 
+ * until the next batch is submitted. 
+ */
+static void reset_latencies(Executor **execs, uint32_t num_workers)
+{
+        uint32_t i;
+
+        for (i = 0; i < num_workers; ++i)
+                execs[i]->Latencies()->Reset();
+        barrier();
+}
+
 static timespec run_experiment(SimpleQueue<ActionBatch> *input_queue,
                                SimpleQueue<ActionBatch> *output_queue,
                                std::vector<ActionBatch> inputs,
+                               Executor **execs,
                                uint32_t num_workers)
 {
         uint32_t num_batches, num_wait_batches, i, j;
@@ -633,6 +967,7 @@ static timespec run_experiment(SimpleQueue<ActionBatch> *input_queue,
                 for (j = 0; j < num_workers; ++j)
                         (&output_queue[j])->DequeueBlocking();
         barrier();
+        reset_latencies(execs, num_workers);
 
         clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start_time);
         barrier();                
@@ -652,10 +987,300 @@ static timespec run_experiment(SimpleQueue<ActionBatch> *input_queue,
         return elapsed_time;
 }
 
+static void init_controller(struct epoch_controller *ctrl, MVConfig config)
+{
+        memset(ctrl, 0x0, sizeof(struct epoch_controller));
+        ctrl->epoch_size = config.epochSize;
+        ctrl->min_size = config.epochSize / ADAPT_RANGE;
+        if (ctrl->min_size == 0)
+                ctrl->min_size = 1;
+        ctrl->max_size = config.epochSize * ADAPT_RANGE;
+        ctrl->target_cycles = 
+                (uint64_t)config.epoch_latency * (FREQUENCY / 1000000);
+}
+
+/* Start a new measurement period. */
+static void reset_controller(struct epoch_controller *ctrl, 
+                             MVScheduler *leader, 
+                             Executor **execs, 
+                             uint32_t num_workers)
+{
+        uint32_t i;
+
+        ctrl->period_start = rdtsc();
+        ctrl->sched_busy = leader->BusyCycles();
+        ctrl->exec_idle = 0;
+        for (i = 0; i < num_workers; ++i) 
+                ctrl->exec_idle += execs[i]->IdleCycles();
+        ctrl->latency_cycles = 0;
+        ctrl->num_batches = 0;
+}
+
+/*
+ * Re-size epochs based on the last measurement period. 
+ * 
+ * If batches take longer than the target latency, halve the epoch. Otherwise, 
+ * if executors sat idle waiting for batches, or the schedulers were saturated,
+ * per-batch coordination dominates, so grow the epoch by a quarter. If neither
+ * holds, the schedulers keep up with the executors with room to spare, so 
+ * shrink the epoch by an eighth to cut latency.
+ */
+static void adapt_epoch_size(struct epoch_controller *ctrl, 
+                             MVScheduler *leader, 
+                             Executor **execs, 
+                             uint32_t num_workers)
+{
+        uint64_t elapsed, busy, idle, latency;
+        uint32_t i, size;
+
+        elapsed = rdtsc() - ctrl->period_start;
+        busy = leader->BusyCycles() - ctrl->sched_busy;
+        idle = 0;
+        for (i = 0; i < num_workers; ++i) 
+                idle += execs[i]->IdleCycles();
+        idle -= ctrl->exec_idle;
+        latency = ctrl->latency_cycles / ctrl->num_batches;
+
+        size = ctrl->epoch_size;
+        if (latency > ctrl->target_cycles) 
+                size -= size / 2;
+        else if (100*idle > ADAPT_IDLE_PCT*elapsed*num_workers ||
+                 100*busy > ADAPT_BUSY_PCT*elapsed) 
+                size += size / 4 + 1;
+        else if (100*busy < ADAPT_SLACK_PCT*elapsed) 
+                size -= size / 8;
+        
+        if (size < ctrl->min_size)
+                size = ctrl->min_size;
+        else if (size > ctrl->max_size)
+                size = ctrl->max_size;
+        ctrl->epoch_size = size;
+        reset_controller(ctrl, leader, execs, num_workers);
+}
+
+/*
+ * Feed the stream of actions to the schedulers in batches sized by the 
+ * controller. Every executor completes batches in order, so once each has 
+ * output a batch, the oldest batch in flight is done. 
+ */
+static timespec run_adaptive_experiment(SimpleQueue<ActionBatch> *input_queue,
+                                        SimpleQueue<ActionBatch> *output_queue,
+                                        std::vector<ActionBatch> dry_runs,
+                                        ActionBatch stream,
+                                        MVScheduler *leader,
+                                        Executor **execs,
+                                        uint32_t num_workers,
+                                        bool snapshot,
+                                        struct epoch_controller *ctrl)
+{
+        uint64_t submit_times[ADAPT_WINDOW], latency;
+        uint32_t sizes[ADAPT_WINDOW];
+        uint32_t head, tail, offset, completed, epoch, i, j;
+        ActionBatch batch;
+        struct timespec elapsed_time, end_time, start_time;
+
+        barrier();
+        for (i = 0; i < MV_DRY_RUNS; ++i)
+                input_queue->EnqueueBlocking(dry_runs[i]);
+        for (i = 0; i < MV_DRY_RUNS; ++i)
+                for (j = 0; j < num_workers; ++j)
+                        (&output_queue[j])->DequeueBlocking();
+        barrier();
+        reset_latencies(execs, num_workers);
+
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start_time);
+        barrier();
+        reset_controller(ctrl, leader, execs, num_workers);
+        head = 0;
+        tail = 0;
+        offset = 0;
+        completed = 0;
+        epoch = MV_DRY_RUNS + 2;
+        while (completed < stream.numActions) {
+                while (tail - head < ADAPT_WINDOW && 
+                       offset < stream.numActions) {
+                        batch.actionBuf = &stream.actionBuf[offset];
+                        batch.threadKeys = NULL;
+                        batch.homeNodes = NULL;
+                        batch.readOnlyBuf = NULL;
+                        batch.numReadOnly = 0;
+                        batch.startTime = 0;
+                        if (stream.homeNodes != NULL)
+                                batch.homeNodes = &stream.homeNodes[offset];
+                        batch.numActions = stream.numActions - offset;
+                        if (batch.numActions > ctrl->epoch_size)
+                                batch.numActions = ctrl->epoch_size;
+                        for (i = 0; i < batch.numActions; ++i) 
+                                batch.actionBuf[i]->__version = 
+                                        CREATE_MV_TIMESTAMP(epoch, i);
+                        sizes[tail % ADAPT_WINDOW] = batch.numActions;
+                        if (snapshot == true)
+                                mv_split_batch(&batch, epoch);
+                        submit_times[tail % ADAPT_WINDOW] = rdtsc();
+                        input_queue->EnqueueBlocking(batch);
+                        offset += sizes[tail % ADAPT_WINDOW];
+                        tail += 1;
+                        epoch += 1;
+                }
+                for (j = 0; j < num_workers; ++j) 
+                        (&output_queue[j])->DequeueBlocking();
+                latency = rdtsc() - submit_times[head % ADAPT_WINDOW];
+                completed += sizes[head % ADAPT_WINDOW];
+                ctrl->latency_cycles += latency;
+                ctrl->num_batches += 1;
+                ctrl->total_latency += latency;
+                ctrl->total_batches += 1;
+                ctrl->total_txns += sizes[head % ADAPT_WINDOW];
+                head += 1;
+                if (ctrl->num_batches == ADAPT_PERIOD) 
+                        adapt_epoch_size(ctrl, leader, execs, num_workers);
+        }
+        barrier();
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end_time);
+        barrier();
+        elapsed_time = diff_time(end_time, start_time);
+        std::cerr << "Done running Bohm experiment!\n";
+        std::cerr << "Final epoch size: " << ctrl->epoch_size << "\n";
+        return elapsed_time;
+}
+
+/*
+ * Generate txns at the offered load and feed them to the schedulers as they 
+ * arrive, while collecting completed batches. Executors complete batches in 
+ * order, so once each has output a batch, the oldest batch in flight is done. 
+ * A txn's latency is measured from its intended arrival time, so that time 
+ * spent behind a backlog is counted.
+ */
+static timespec run_stream_experiment(SimpleQueue<ActionBatch> *input_queue,
+                                      SimpleQueue<ActionBatch> *output_queue,
+                                      std::vector<ActionBatch> dry_runs,
+                                      Executor **execs,
+                                      MVConfig config,
+                                      workload_config w_config,
+                                      int *partition_nodes,
+                                      struct stream_client *client)
+{
+        ActionBatch window[STREAM_WINDOW], batch, done;
+        uint32_t starts[STREAM_WINDOW], completions[config.numWorkerThreads];
+        uint32_t generated, offset, completed, epoch, head, tail, i, j;
+        uint32_t start, count;
+        uint64_t now, next_arrival, max_delay;
+        mv_action **stream;
+        struct timespec elapsed_time, end_time, start_time;
+
+        stream = (mv_action**)malloc(sizeof(mv_action*)*client->num_txns);
+        assert(stream != NULL);
+        max_delay = STREAM_MAX_DELAY*(FREQUENCY/1000000);
+        for (j = 0; j < config.numWorkerThreads; ++j) 
+                completions[j] = 0;
+
+        barrier();
+        for (i = 0; i < MV_DRY_RUNS; ++i)
+                input_queue->EnqueueBlocking(dry_runs[i]);
+        for (i = 0; i < MV_DRY_RUNS; ++i)
+                for (j = 0; j < config.numWorkerThreads; ++j)
+                        (&output_queue[j])->DequeueBlocking();
+        barrier();
+        reset_latencies(execs, config.numWorkerThreads);
+
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start_time);
+        barrier();
+        generated = 0;
+        offset = 0;
+        completed = 0;
+        head = 0;
+        tail = 0;
+        epoch = MV_DRY_RUNS + 2;
+        next_arrival = rdtsc();
+        while (completed < client->num_txns) {
+                now = rdtsc();
+                /* 
+                 * A full batch holds back later arrivals until it can be 
+                 * submitted, their latency still counts from their arrival. 
+                 */
+                if (generated < client->num_txns && now >= next_arrival &&
+                    generated - offset < config.epochSize) {
+                        stream[generated] = 
+                                generate_mv_action(generate_transaction(w_config));
+                        client->arrivals[generated] = next_arrival;
+                        generated += 1;
+                        next_arrival += client->interval;
+                }
+                
+                /* Close the pending batch if it is full or has waited long. */
+                if (generated > offset && tail - head < STREAM_WINDOW &&
+                    (generated - offset == config.epochSize || 
+                     generated == client->num_txns ||
+                     now - client->arrivals[offset] >= max_delay)) {
+                        batch.actionBuf = &stream[offset];
+                        batch.numActions = generated - offset;
+                        batch.threadKeys = NULL;
+                        batch.homeNodes = NULL;
+                        batch.readOnlyBuf = NULL;
+                        batch.numReadOnly = 0;
+                        batch.startTime = 0;
+                        for (i = 0; i < batch.numActions; ++i) 
+                                batch.actionBuf[i]->__version = 
+                                        CREATE_MV_TIMESTAMP(epoch, i);
+                        if (config.snapshot == true)
+                                mv_split_batch(&batch, epoch);
+                        if (partition_nodes != NULL)
+                                mv_route_batch(&batch, partition_nodes);
+                        window[tail % STREAM_WINDOW] = batch;
+                        starts[tail % STREAM_WINDOW] = offset;
+                        input_queue->EnqueueBlocking(batch);
+                        offset = generated;
+                        tail += 1;
+                        epoch += 1;
+                }
+
+                for (j = 0; j < config.numWorkerThreads; ++j) 
+                        while ((&output_queue[j])->Dequeue(&done))
+                                completions[j] += 1;
+                while (head < tail) {
+                        for (j = 0; j < config.numWorkerThreads; ++j) 
+                                if (completions[j] <= head)
+                                        break;
+                        if (j < config.numWorkerThreads)
+                                break;
+                        now = rdtsc();
+                        batch = window[head % STREAM_WINDOW];
+                        count = batch.numActions + batch.numReadOnly;
+                        start = starts[head % STREAM_WINDOW];
+                        for (i = start; i < start + count; ++i) 
+                                client->latencies.Record(now - 
+                                                         client->arrivals[i]);
+                        completed += count;
+                        free(batch.homeNodes);
+                        head += 1;
+                }
+        }
+        barrier();
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end_time);
+        barrier();
+        client->num_batches = tail;
+        elapsed_time = diff_time(end_time, start_time);
+        std::cerr << "Done running Bohm experiment!\n";
+        return elapsed_time;
+}
+
+static void init_stream_client(struct stream_client *client, MVConfig config)
+{
+        assert(config.stream_rate > 0);
+        client->interval = FREQUENCY / config.stream_rate;
+        client->num_txns = config.numTxns;
+        client->num_batches = 0;
+        client->arrivals = 
+                (uint64_t*)malloc(sizeof(uint64_t)*client->num_txns);
+        assert(client->arrivals != NULL);
+        client->latencies.Reset();
+}
+
 static void init_database(MVConfig config,
                           workload_config w_conf,
                           SimpleQueue<ActionBatch> *input_queue,
                           SimpleQueue<ActionBatch> *output_queue,
+                          MVActionHasher *hasher,
                           MVScheduler **sched_threads,
                           Executor **exec_threads)
                           
@@ -670,6 +1295,10 @@ static void init_database(MVConfig config,
                 sched_threads[i]->Run();        
                 sched_threads[i]->WaitInit();
         }
+        if (hasher != NULL) {
+                hasher->Run();
+                hasher->WaitInit();
+        }
         for (i = 0; i < config.numWorkerThreads; ++i) {
                 exec_threads[i]->Run();
                 exec_threads[i]->WaitInit();                
@@ -683,10 +1312,46 @@ static void init_database(MVConfig config,
         return;
 }
 
+/*
+ * Home each CC thread's records on a NUMA node which runs executors, so that 
+ * actions can run next to the records they touch. CC threads are spread 
+ * round-robin across the executors' nodes. Returns a cpu on, and the id of, 
+ * each CC thread's home node, indexed by CC threadId.
+ */
+static void setup_partition_homes(MVConfig config, int **cpus_OUT, 
+                                  int **nodes_OUT)
+{
+        int node_cpus[config.numWorkerThreads], *cpus, *nodes, cpu;
+        uint32_t num_nodes, i, j;
+
+        num_nodes = 0;
+        for (i = 0; i < config.numWorkerThreads; ++i) {
+                cpu = (int)(config.numCCThreads + i);
+                for (j = 0; j < num_nodes; ++j) 
+                        if (numa_node_of_cpu(node_cpus[j]) == 
+                            numa_node_of_cpu(cpu))
+                                break;
+                if (j == num_nodes) 
+                        node_cpus[num_nodes++] = cpu;
+        }
+        assert(num_nodes > 0);
+        cpus = (int*)malloc(sizeof(int)*config.numCCThreads);
+        nodes = (int*)malloc(sizeof(int)*config.numCCThreads);
+        assert(cpus != NULL && nodes != NULL);
+        for (i = 0; i < config.numCCThreads; ++i) {
+                cpus[i] = node_cpus[i % num_nodes];
+                nodes[i] = numa_node_of_cpu(cpus[i]);
+        }
+        *cpus_OUT = cpus;
+        *nodes_OUT = nodes;
+}
+
 static MVScheduler** setup_scheduler_threads(MVConfig config,
                                              SimpleQueue<ActionBatch> **sched_input,
                                              SimpleQueue<ActionBatch> **sched_output,
-                                             SimpleQueue<MVRecordList> ***gc_queues)
+                                             SimpleQueue<MVRecordList> ***gc_queues,
+                                             int *record_cpus,
+                                             volatile uint32_t *epochs)
 {
         uint64_t stickies_per_thread;
         uint32_t num_tables;
@@ -704,12 +1369,17 @@ static MVScheduler** setup_scheduler_threads(MVConfig config,
         } else {
                 assert(false);
         }
+        assert(config.index_type == MV_CHAINED_INDEX ||
+               config.index_type == MV_BUCKET_INDEX);
         schedulers = SetupSchedulers(config.numCCThreads, sched_input,
                                      sched_output, config.numWorkerThreads+1,
                                      stickies_per_thread, num_tables,
                                      config.numRecords, gc_queues,
                                      worker_start,
-                                     worker_end);
+                                     worker_end,
+                                     (MVIndexType)config.index_type,
+                                     record_cpus,
+                                     &epochs[config.numWorkerThreads]);
         assert(schedulers != NULL);
         assert(*sched_input != NULL);
         assert(*sched_output != NULL);
@@ -719,26 +1389,83 @@ static MVScheduler** setup_scheduler_threads(MVConfig config,
         return schedulers;
 }
 
+/* 
+ * Put an MVActionHasher in front of the schedulers, on the first core after 
+ * the executors. sched_input is redirected to the hasher's input queue.
+ */
+static MVActionHasher* setup_hasher(MVConfig config,
+                                    SimpleQueue<ActionBatch> **sched_input)
+{
+        MVActionHasher *hasher;
+        SimpleQueue<ActionBatch> *input;
+        char *input_array;
+        int cpu;
+
+        cpu = (int)(config.numCCThreads + config.numWorkerThreads);
+        input_array = (char*)alloc_mem(CACHE_LINE*INPUT_SIZE, cpu);
+        assert(input_array != NULL);
+        input = new SimpleQueue<ActionBatch>(input_array, INPUT_SIZE, parkQueues);
+        hasher = new (cpu) MVActionHasher(cpu, input, *sched_input);
+        *sched_input = input;
+        std::cerr << "Done setting up hasher thread!\n";
+        return hasher;
+}
+
+/* 
+ * Wrap the CC threads' partitions of each table, so that executors can look up
+ * the versions read by snapshot reads.
+ */
+static MVTable** setup_snapshot_tables(MVConfig config, 
+                                       MVScheduler **schedulers)
+{
+        MVTable **tables;
+        uint32_t num_tables, i, j;
+        
+        num_tables = config.experiment < 3? 1 : 2;
+        tables = (MVTable**)malloc(sizeof(MVTable*)*num_tables);
+        assert(tables != NULL);
+        for (i = 0; i < num_tables; ++i) {
+                tables[i] = new MVTable(config.numCCThreads);
+                for (j = 0; j < config.numCCThreads; ++j) 
+                        tables[i]->AddPartition(j, 
+                                                schedulers[j]->GetPartition(i));
+        }
+        return tables;
+}
+
 static Executor** setup_executors(MVConfig config,
                                   SimpleQueue<ActionBatch> *sched_outputs,
                                   SimpleQueue<ActionBatch> *output_queue,
-                                  SimpleQueue<MVRecordList> ***gc_queues)
+                                  SimpleQueue<MVRecordList> ***gc_queues,
+                                  int *partition_nodes,
+                                  MVTable **tables,
+                                  volatile uint32_t *epochs)
 {
         uint32_t start_cpu, queues_per_table, queues_per_cc_thread;
+        WorkStealingDeque<mv_action*> **deques;
         Executor **execs;
         start_cpu = config.numCCThreads;
         queues_per_table = config.numWorkerThreads;
         queues_per_cc_thread = config.numWorkerThreads;
+        deques = NULL;
+        if (config.work_stealing == true && config.epoch_latency > 0)
+                deques = SetupDeques(start_cpu, config.numWorkerThreads,
+                                     config.epochSize*ADAPT_RANGE);
+        else if (config.work_stealing == true)
+                deques = SetupDeques(start_cpu, config.numWorkerThreads,
+                                     config.epochSize);
         execs = SetupExecutors(start_cpu, config.numWorkerThreads,
                                config.numCCThreads, queues_per_table,
                                sched_outputs, output_queue,
-                               queues_per_cc_thread, gc_queues);
+                               queues_per_cc_thread, gc_queues, deques,
+                               partition_nodes, tables, epochs);
         std::cerr << "Done setting up executors!\n";
         return execs;
 }
 
 void do_mv_experiment(MVConfig mv_config, workload_config w_config)
 {
+        MVActionHasher *hasher;
         MVScheduler **schedThreads;
         Executor **execThreads;
         SimpleQueue<ActionBatch> *schedInputQueue;
@@ -746,6 +1473,12 @@ void do_mv_experiment(MVConfig mv_config, workload_config w_config)
         SimpleQueue<MVRecordList> **schedGCQueues[mv_config.numCCThreads];
         SimpleQueue<ActionBatch> *outputQueue;
         std::vector<ActionBatch> input_placeholder;
+        ActionBatch stream;
+        struct epoch_controller ctrl;
+        struct stream_client client;
+        int *record_cpus, *partition_nodes;
+        MVTable **tables;
+        volatile uint32_t *epochs;
         timespec elapsed_time;
 
         /* 
@@ -761,21 +1494,74 @@ void do_mv_experiment(MVConfig mv_config, workload_config w_config)
         MVScheduler::NUM_CC_THREADS = (uint32_t)mv_config.numCCThreads;
         NUM_CC_THREADS = (uint32_t)mv_config.numCCThreads;
         assert(mv_config.distribution < 2);
+        parkQueues = mv_config.park;
         outputQueue = SetupQueuesMany<ActionBatch>(INPUT_SIZE,
                                                    mv_config.numWorkerThreads,
                                                    71);
+        record_cpus = NULL;
+        partition_nodes = NULL;
+        if (mv_config.numa == true)
+                setup_partition_homes(mv_config, &record_cpus, &partition_nodes);
+        epochs = SetupEpochs(mv_config.numWorkerThreads);
         schedThreads = setup_scheduler_threads(mv_config, &schedInputQueue,
                                                &schedOutputQueues,
-                                               schedGCQueues);
-        mv_setup_input_array(&input_placeholder, mv_config, w_config);
+                                               schedGCQueues, record_cpus,
+                                               epochs);
+        hasher = NULL;
+        if (mv_config.presort == true)
+                hasher = setup_hasher(mv_config, &schedInputQueue);
+        assert(mv_config.stream_rate == 0 || mv_config.epoch_latency == 0);
+        if (mv_config.stream_rate > 0)
+                mv_setup_stream_input(&input_placeholder, mv_config, w_config,
+                                      partition_nodes);
+        else if (mv_config.epoch_latency > 0)
+                mv_setup_adaptive_input(&input_placeholder, &stream, mv_config,
+                                        w_config, partition_nodes);
+        else
+                mv_setup_input_array(&input_placeholder, mv_config, w_config,
+                                     partition_nodes);
+        tables = NULL;
+        if (mv_config.snapshot == true)
+                tables = setup_snapshot_tables(mv_config, schedThreads);
         execThreads = setup_executors(mv_config, schedOutputQueues, outputQueue,
-                                      schedGCQueues);
+                                      schedGCQueues, partition_nodes, tables,
+                                      epochs);
         init_database(mv_config, w_config, schedInputQueue, outputQueue,
-                      schedThreads, execThreads);
+                      hasher, schedThreads, execThreads);
         pin_memory();
+        if (mv_config.epoch_latency > 0) {
+                init_controller(&ctrl, mv_config);
+                elapsed_time = run_adaptive_experiment(schedInputQueue,
+                                                       outputQueue,
+                                                       input_placeholder,
+                                                       stream,
+                                                       schedThreads[0],
+                                                       execThreads,
+                                                       mv_config.numWorkerThreads,
+                                                       mv_config.snapshot,
+                                                       &ctrl);
+                write_results(mv_config, elapsed_time, &ctrl, NULL, 
+                              schedThreads, execThreads);
+                return;
+        }
+        if (mv_config.stream_rate > 0) {
+                init_stream_client(&client, mv_config);
+                elapsed_time = run_stream_experiment(schedInputQueue,
+                                                     outputQueue,
+                                                     input_placeholder,
+                                                     execThreads,
+                                                     mv_config, w_config,
+                                                     partition_nodes,
+                                                     &client);
+                write_results(mv_config, elapsed_time, NULL, &client,
+                              schedThreads, execThreads);
+                return;
+        }
         elapsed_time = run_experiment(schedInputQueue,  //&schedOutputQueues[config.numWorkerThreads],
                                       outputQueue,
                                       input_placeholder,// 1);
+                                      execThreads,
                                       mv_config.numWorkerThreads);
-        write_results(mv_config, elapsed_time);
+        write_results(mv_config, elapsed_time, NULL, NULL, schedThreads,
+                      execThreads);
 }
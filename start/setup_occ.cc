@@ -6,12 +6,17 @@
 #include <fstream>
 #include <setup_workload.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <common_constants.h>
+#include <occ_logger.h>
+#include <occ_checkpoint.h>
+#include <occ_table.h>
 
 extern uint32_t GLOBAL_RECORD_SIZE;
 
 
-Table** setup_occ_lock_tables(int start_cpu, int end_cpu, uint32_t table_sz)
+Table** setup_occ_lock_tables(int start_cpu, int end_cpu, uint32_t table_sz,
+                             bool inline_table)
 {
         assert(READ_COMMITTED);
         uint64_t val;
@@ -30,7 +35,10 @@ Table** setup_occ_lock_tables(int start_cpu, int end_cpu, uint32_t table_sz)
                 sizeof(uint64_t),
         };
         ret = (Table**)malloc(sizeof(Table*));
-        ret[0] = new (0) Table(conf);
+        if (inline_table)
+                ret[0] = new (0) OCCTable(conf);
+        else
+                ret[0] = new (0) Table(conf);
         
         /* Initialize the table */
         val = 0;
@@ -90,6 +98,15 @@ OCCAction** create_single_occ_action_batch(uint32_t batch_size,
         return ret;
 }
 
+/* 
+ * Index of the first worker which runs txns. Worker 0 advances epochs, unless 
+ * workers advance them themselves.
+ */
+static uint32_t occ_first_runner(OCCConfig config)
+{
+        return config.epoch_us > 0 ? 0 : 1;
+}
+
 OCCActionBatch** setup_occ_input(OCCConfig occ_config, workload_config w_conf,
                                  uint32_t extra_batches)
 {
@@ -117,7 +134,7 @@ OCCActionBatch* setup_occ_single_input(OCCConfig config, workload_config w_conf)
         uint32_t txns_per_thread, remainder, i;
         OCCAction **actions;
 
-        config.numThreads -= 1;
+        config.numThreads -= occ_first_runner(config);
         ret = (OCCActionBatch*)malloc(sizeof(OCCActionBatch)*config.numThreads);
         txns_per_thread = (config.numTxns)/config.numThreads;
         remainder = (config.numTxns) % config.numThreads;
@@ -134,15 +151,61 @@ OCCActionBatch* setup_occ_single_input(OCCConfig config, workload_config w_conf)
         return ret;
 }
 
+/*
+ * Create the logger, and a log channel for each worker which runs txns. 
+ * Worker 0 has no channel if it only advances epochs.
+ */
+OCCLogger* setup_occ_logger(OCCConfig config, occ_log_channel ***channels_OUT,
+                            volatile uint32_t **durable_OUT)
+{
+        occ_log_channel **channels;
+        volatile uint32_t *durable_epoch;
+        OCCLoggerConfig logger_config;
+        uint32_t i, first;
+        int fd;
+
+        first = occ_first_runner(config);
+        fd = open(config.log_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        assert(fd >= 0);
+        channels = (occ_log_channel**)malloc(sizeof(occ_log_channel*)*
+                                             config.numThreads);
+        channels[0] = NULL;
+        for (i = first; i < config.numThreads; ++i) 
+                channels[i] = OCCLogger::CreateChannel(OCC_LOG_SIZE, i);
+        durable_epoch = (volatile uint32_t*)alloc_mem(CACHE_LINE, 0);
+        *durable_epoch = 0;
+        logger_config = {
+                (int)config.numThreads,
+                fd,
+                &channels[first],
+                config.numThreads - first,
+                durable_epoch,
+        };
+        *channels_OUT = channels;
+        *durable_OUT = durable_epoch;
+        return new((int)config.numThreads) OCCLogger(logger_config);
+}
+
 OCCWorker** setup_occ_workers(SimpleQueue<OCCActionBatch> **inputQueue,
                               SimpleQueue<OCCActionBatch> **outputQueue,
                               Table **tables, int numThreads,
                               uint64_t epoch_threshold, uint32_t numTables, 
-                              uint32_t num_records)
+                              uint32_t num_records,
+                              occ_log_channel **log_channels,
+                              volatile uint32_t *durable_epoch,
+                              volatile uint32_t **epoch_OUT,
+                              bool inline_tables,
+                              bool epoch_deadlines,
+                              uint32_t filter_bits,
+                              uint32_t hot_threshold,
+                              uint64_t backoff)
 {
         uint32_t recordSizes[2];
         OCCWorker **workers;
         volatile uint32_t *epoch_ptr;
+        volatile uint64_t *epoch_deadline;
+        OCCWriteFilter *write_filter;
+        OCCTemperature *temperature;
         int i;
         bool is_leader;
         Table **tables_copy, **lock_tables, **lock_tables_copy;
@@ -158,9 +221,26 @@ OCCWorker** setup_occ_workers(SimpleQueue<OCCActionBatch> **inputQueue,
         barrier();
         *epoch_ptr = 0;
         barrier();
+        epoch_deadline = NULL;
+        if (epoch_deadlines) {
+                epoch_deadline = (volatile uint64_t*)alloc_mem(CACHE_LINE, 0);
+                assert(epoch_deadline != NULL);
+                *epoch_deadline = 0;
+        }
+        write_filter = NULL;
+        if (filter_bits > 0)
+                write_filter = new(0) OCCWriteFilter(filter_bits);
+        temperature = NULL;
+        if (hot_threshold > 0) {
+
+                /* Read committed txns never abort. */
+                assert(!READ_COMMITTED);
+                temperature = new(0) OCCTemperature(hot_threshold);
+        }
 
         if (READ_COMMITTED)
-                lock_tables = setup_occ_lock_tables(0, numThreads, num_records);
+                lock_tables = setup_occ_lock_tables(0, numThreads, num_records,
+                                                    inline_tables);
         else
                 lock_tables = NULL;
         lock_tables_copy = NULL;
@@ -192,6 +272,12 @@ OCCWorker** setup_occ_workers(SimpleQueue<OCCActionBatch> **inputQueue,
                         OCC_LOG_SIZE,
                         false,
                         numTables,
+                        log_channels == NULL ? NULL : log_channels[i],
+                        durable_epoch,
+                        epoch_deadline,
+                        write_filter,
+                        temperature,
+                        backoff,
                 };
                 buf_config = {
                         numTables,
@@ -202,6 +288,7 @@ OCCWorker** setup_occ_workers(SimpleQueue<OCCActionBatch> **inputQueue,
                 workers[i] = new(i) OCCWorker(worker_config, buf_config);
         }
         std::cerr << "Done setting up occ workers\n";
+        *epoch_OUT = epoch_ptr;
         return workers;
 }
 
@@ -228,6 +315,50 @@ Table** setup_hash_tables(uint32_t num_tables, uint32_t *num_records, bool occ)
         return tables;
 }
 
+/* 
+ * Load the tables from a checkpoint image, in parallel. Returns an empty setup 
+ * batch, so populate_tables only has to mark the tables initialized.
+ */
+static OCCActionBatch restore_db(OCCConfig config, Table **tables,
+                                 uint32_t num_tables)
+{
+        timespec start_time, end_time, elapsed;
+        OCCActionBatch ret;
+
+        clock_gettime(CLOCK_REALTIME, &start_time);
+        occ_load_checkpoint(config.restore_file, tables, num_tables,
+                            config.numThreads);
+        clock_gettime(CLOCK_REALTIME, &end_time);
+        elapsed = diff_time(end_time, start_time);
+        std::cerr << "Restore time: ";
+        std::cerr << (((double)elapsed.tv_sec*1000) + 
+                      (((double)elapsed.tv_nsec)/1000000.0)) << "\n";
+        ret.batchSize = 0;
+        ret.batch = NULL;
+        return ret;
+}
+
+static Table** setup_occ_inline_tables(uint32_t num_tables,
+                                       uint32_t *num_records)
+{
+        Table **tables;
+        uint32_t i;
+        TableConfig conf;
+
+        tables = (Table**)malloc(sizeof(Table*)*num_tables);
+        for (i = 0; i < num_tables; ++i) {
+                conf.tableId = i;
+                conf.numBuckets = (uint64_t)num_records[i];
+                conf.startCpu = 0;
+                conf.endCpu = 71;
+                conf.freeListSz = num_records[i];
+                conf.valueSz = GLOBAL_RECORD_SIZE + 8;
+                conf.recordSize = 0;
+                tables[i] = new(0) OCCTable(conf);
+        }
+        return tables;
+}
+
 static OCCActionBatch setup_db(workload_config conf)
 {
         txn **loader_txns;
@@ -260,6 +391,23 @@ void write_occ_output(struct occ_result result, OCCConfig config,
         result_file << " threads:" << config.numThreads << " occ ";
         result_file << "records:" << config.numRecords << " ";
         result_file << "read_pct:" << config.read_pct << " ";
+        result.latencies.WritePercentiles(result_file);
+        result_file << "aborts:" << result.num_aborts << " ";
+        result_file << "abort_rate:";
+        result_file << (double)result.num_aborts / 
+                (result.num_aborts + result.num_completed) << " ";
+        if (config.backoff > 0)
+                result_file << "backoff:" << config.backoff << " ";
+        if (config.log_file != NULL)
+                result_file << "durable ";
+        if (config.inline_table)
+                result_file << "inline_table ";
+        if (config.epoch_us > 0)
+                result_file << "epoch_us:" << config.epoch_us << " ";
+        if (config.filter_bits > 0)
+                result_file << "filter_bits:" << config.filter_bits << " ";
+        if (config.hot_threshold > 0)
+                result_file << "hot_threshold:" << config.hot_threshold << " ";
 
         if (config.experiment == 2)
                 result_file << "hot_position:" << w_conf.hot_position << " ";
@@ -301,7 +449,8 @@ uint64_t get_completed_count(OCCWorker **workers, uint32_t num_workers,
 }
 
 uint64_t wait_to_completion(__attribute__((unused)) SimpleQueue<OCCActionBatch> **output_queues,
-                            uint32_t num_workers, OCCWorker **workers)
+                            uint32_t first, uint32_t num_workers,
+                            OCCWorker **workers, bool durable)
 {        
         uint32_t i;
         uint64_t num_completed = 0;
@@ -310,8 +459,11 @@ uint64_t wait_to_completion(__attribute__((unused)) SimpleQueue<OCCActionBatch>
         //                output_queues[i]->DequeueBlocking();
 
         sleep(60);
-                for (i = 1; i < num_workers; ++i) 
-                        num_completed += workers[i]->NumCompleted();
+                for (i = first; i < num_workers; ++i) 
+                        if (durable)
+                                num_completed += workers[i]->NumDurable();
+                        else
+                                num_completed += workers[i]->NumCompleted();
         return num_completed;
 }
 
@@ -334,13 +486,13 @@ void populate_tables(SimpleQueue<OCCActionBatch> *input_queue,
 void dry_run(SimpleQueue<OCCActionBatch> **input_queues, 
              SimpleQueue<OCCActionBatch> **output_queues,
              OCCActionBatch *input_batches,
-             uint32_t num_workers)
+             uint32_t first, uint32_t num_workers)
 {
         uint32_t i;
-        for (i = 1; i < num_workers; ++i) 
-                input_queues[i]->EnqueueBlocking(input_batches[i-1]);
+        for (i = first; i < num_workers; ++i) 
+                input_queues[i]->EnqueueBlocking(input_batches[i-first]);
         barrier();
-        for (i = 1; i < num_workers; ++i) 
+        for (i = first; i < num_workers; ++i) 
                 output_queues[i]->DequeueBlocking();
 }
 
@@ -352,11 +504,15 @@ struct occ_result do_measurement(SimpleQueue<OCCActionBatch> **inputQueues,
                                  OCCConfig config,
                                  OCCActionBatch setup_txns,
                                  Table **tables,
-                                 uint32_t num_tables)
+                                 uint32_t num_tables,
+                                 OCCCheckpointer *checkpointer)
 {
         timespec start_time, end_time;
-        uint32_t i, j;
+        uint32_t i, j, first;
+        uint64_t dry_aborts;
         struct occ_result result;
+
+        first = occ_first_runner(config);
                 std::cerr << "Num batches " << num_batches << "\n";
         for (i = 0; i < config.numThreads; ++i) {
                 workers[i]->Run();
@@ -365,26 +521,46 @@ struct occ_result do_measurement(SimpleQueue<OCCActionBatch> **inputQueues,
 
         populate_tables(inputQueues[1], outputQueues[1], setup_txns, tables,
                         num_tables);
-        dry_run(inputQueues, outputQueues, inputBatches[0], config.numThreads);
+        dry_run(inputQueues, outputQueues, inputBatches[0], first,
+                config.numThreads);
 
         std::cerr << "Done dry run\n";
+        dry_aborts = 0;
+        for (i = 0; i < config.numThreads; ++i)
+                dry_aborts += workers[i]->NumAborts();
+        if (checkpointer != NULL) {
+                checkpointer->Run();
+                checkpointer->WaitInit();
+        }
         barrier();
         clock_gettime(CLOCK_REALTIME, &start_time);
         barrier();
         for (i = 0; i < num_batches; ++i) 
-                for (j = 0; j < config.numThreads-1; ++j) 
-                        inputQueues[j+1]->EnqueueBlocking(inputBatches[i+1][j]);
+                for (j = first; j < config.numThreads; ++j) 
+                        inputQueues[j]->EnqueueBlocking(inputBatches[i+1][j-first]);
         barrier();
-        result.num_txns = wait_to_completion(outputQueues, config.numThreads, 
-                                             workers);
+        result.num_txns = wait_to_completion(outputQueues, first,
+                                             config.numThreads, workers,
+                                             config.log_file != NULL);
         barrier();
         clock_gettime(CLOCK_REALTIME, &end_time);
         barrier();
         result.time_elapsed = diff_time(end_time, start_time);
-        for (i = 0; i < config.numThreads-1; ++i)
+        result.num_completed = 0;
+        result.num_aborts = 0;
+        for (i = 0; i < config.numThreads; ++i) {
+                result.latencies.Merge(*workers[i]->Latencies());
+                result.num_completed += workers[i]->NumCompleted();
+                result.num_aborts += workers[i]->NumAborts();
+        }
+        for (i = 0; i < config.numThreads-first; ++i) {
                 result.num_txns -= inputBatches[0][i].batchSize;
+                result.num_completed -= inputBatches[0][i].batchSize;
+        }
+        result.num_aborts -= dry_aborts;
         //        result.num_txns = config.numTxns;
         std::cout << "Num completed: " << result.num_txns << "\n";
+        std::cout << "Num aborts: " << result.num_aborts << "\n";
         return result;
 }
 
@@ -394,7 +570,8 @@ struct occ_result run_occ_workers(SimpleQueue<OCCActionBatch> **inputQueues,
                                   OCCActionBatch **inputBatches,
                                   uint32_t num_batches,
                                   OCCConfig config, OCCActionBatch setup_txns,
-                                  Table **tables, uint32_t num_tables)
+                                  Table **tables, uint32_t num_tables,
+                                  OCCCheckpointer *checkpointer)
 {
         int success;
         struct occ_result result;        
@@ -403,7 +580,7 @@ struct occ_result run_occ_workers(SimpleQueue<OCCActionBatch> **inputQueues,
         assert(success == 0);
         result = do_measurement(inputQueues, outputQueues, workers,
                                 inputBatches, num_batches, config, setup_txns,
-                                tables, num_tables);
+                                tables, num_tables, checkpointer);
         std::cerr << "Done experiment!\n";
         return result;
 }
@@ -415,17 +592,24 @@ void occ_experiment(OCCConfig occ_config, workload_config w_conf)
         OCCWorker **workers;
         OCCActionBatch **inputs;
         OCCActionBatch setup_txns;
+        OCCLogger *logger;
+        OCCCheckpointer *checkpointer;
+        OCCCheckpointerConfig ckpt_config;
+        occ_log_channel **log_channels;
+        volatile uint32_t *durable_epoch, *epoch_ptr;
         
         struct occ_result result;
         uint32_t num_records[2];
         uint32_t num_tables;
         
 	occ_config.occ_epoch = OCC_EPOCH_SIZE;
+        if (occ_config.epoch_us > 0)
+                occ_config.occ_epoch = 
+                        (uint64_t)occ_config.epoch_us*(FREQUENCY/1000000);
         input_queues = setup_queues<OCCActionBatch>(occ_config.numThreads,
                                                     1024);
         output_queues = setup_queues<OCCActionBatch>(occ_config.numThreads,
                                                      1024);
-        setup_txns = setup_db(w_conf);
         if (occ_config.experiment < 3) {
                 num_tables = 1;
                 num_records[0] = occ_config.numRecords;
@@ -438,15 +622,56 @@ void occ_experiment(OCCConfig occ_config, workload_config w_conf)
                 tables = NULL;
                 num_tables = 0;
         }
-        tables = setup_hash_tables(num_tables, num_records, true);
+        if (occ_config.inline_table) {
+
+                /* Checkpoints walk and rebuild hash chains. */
+                assert(occ_config.checkpoint_file == NULL &&
+                       occ_config.restore_file == NULL);
+                tables = setup_occ_inline_tables(num_tables, num_records);
+        } else {
+                tables = setup_hash_tables(num_tables, num_records, true);
+        }
+        if (occ_config.restore_file != NULL)
+                setup_txns = restore_db(occ_config, tables, num_tables);
+        else
+                setup_txns = setup_db(w_conf);
+        log_channels = NULL;
+        durable_epoch = NULL;
+        if (occ_config.log_file != NULL) {
+                logger = setup_occ_logger(occ_config, &log_channels,
+                                          &durable_epoch);
+                logger->Run();
+                logger->WaitInit();
+        }
         workers = setup_occ_workers(input_queues, output_queues, tables,
                                     occ_config.numThreads, occ_config.occ_epoch,
-                                    2, num_records[0]);
+                                    2, num_records[0], log_channels, 
+                                    durable_epoch, &epoch_ptr,
+                                    occ_config.inline_table,
+                                    occ_config.epoch_us > 0,
+                                    occ_config.filter_bits,
+                                    occ_config.hot_threshold,
+                                    occ_config.backoff);
+        checkpointer = NULL;
+        if (occ_config.checkpoint_file != NULL) {
+                ckpt_config = {
+                        (int)occ_config.numThreads+1,
+                        occ_config.checkpoint_file,
+                        tables,
+                        num_tables,
+                        epoch_ptr,
+                };
+                checkpointer = new((int)occ_config.numThreads+1)
+                        OCCCheckpointer(ckpt_config);
+        }
 
         inputs = setup_occ_input(occ_config, w_conf, 1);
         pin_memory();
         result = run_occ_workers(input_queues, output_queues, workers,
                                  inputs, 1+1, occ_config,
-                                 setup_txns, tables, num_tables);
+                                 setup_txns, tables, num_tables,
+                                 checkpointer);
+        if (checkpointer != NULL)
+                checkpointer->Join();
         write_occ_output(result, occ_config, w_conf);
 }
@@ -11,10 +11,15 @@
 #include <table.h>
 #include <occ.h>
 #include <record_generator.h>
+#include <latency_histogram.h>
+#include <occ_checkpoint.h>
 
 struct occ_result {
         timespec time_elapsed;
-        uint64_t num_txns;
+        uint64_t num_txns;              /* Durable ones if logging */
+        uint64_t num_completed;
+        uint64_t num_aborts;
+        LatencyHistogram latencies;
 };
 
 OCCAction** create_single_occ_action_batch(uint32_t batch_size,
@@ -53,7 +58,8 @@ struct occ_result do_measurement(SimpleQueue<OCCActionBatch> **inputQueues,
                                  OCCConfig config,
                                  OCCActionBatch setup_txns,
                                  Table **tables,
-                                 uint32_t num_tables);
+                                 uint32_t num_tables,
+                                 OCCCheckpointer *checkpointer);
 
 struct occ_result run_occ_workers(SimpleQueue<OCCActionBatch> **inputQueues,
                                   SimpleQueue<OCCActionBatch> **outputQueues,
@@ -0,0 +1,205 @@
+#include "gtest/gtest.h"
+#include "executor.h"
+#include "test/test_txn.h"
+
+#include <cstring>
+
+// Two executors which steal from each other's deques. Only thread 1 is ever
+// run, thread 0 is a peer whose deque and epoch the test sets by hand.
+class ExecutorTest : public testing::Test {
+protected:
+  static const uint64_t dequeSize = 16;
+  mv_action *dequeBufs[2][dequeSize];
+  WorkStealingDeque<mv_action*> *deques[2];
+  volatile uint32_t epochs[2];
+  volatile uint32_t watermark;
+  Executor *exec;
+
+  virtual void SetUp() {
+    ExecutorConfig config;
+
+    memset(&config, 0x0, sizeof(config));
+    deques[0] = new WorkStealingDeque<mv_action*>(dequeBufs[0], dequeSize);
+    deques[1] = new WorkStealingDeque<mv_action*>(dequeBufs[1], dequeSize);
+    epochs[0] = 0;
+    epochs[1] = 0;
+    watermark = 0;
+    config.threadId = 1;
+    config.numExecutors = 2;
+    config.epochPtr = &epochs[1];
+    config.lowWaterMarkPtr = &watermark;
+    config.deques = deques;
+    config.garbageConfig.numCCThreads = 1;
+    config.garbageConfig.numWorkers = 1;
+    config.garbageConfig.numTables = 1;
+    config.garbageConfig.lowWaterMarkPtr = &watermark;
+    exec = new(0) Executor(config);
+  }
+
+  mv_action* make_action(uint32_t epoch, uint32_t counter) {
+    mv_action *action = new mv_action(new TestTxn());
+    action->__version = CREATE_MV_TIMESTAMP(epoch, counter);
+    return action;
+  }
+
+  bool steal(mv_action **action, uint32_t epoch) {
+    return exec->StealAction(action, epoch);
+  }
+
+  bool process(mv_action *action) {
+    return exec->ProcessSingle(action);
+  }
+
+  void set_tables(MVTable **tables) {
+    exec->config.tables = tables;
+  }
+};
+
+TEST_F(ExecutorTest, stealSameBatchTest) {
+  mv_action *a = make_action(1, 0), *b = make_action(1, 1), *stolen;
+
+  // Both threads have completed epoch 0, and are running the batch of epoch 1.
+  ASSERT_TRUE(deques[0]->Push(a));
+  ASSERT_TRUE(deques[0]->Push(b));
+  ASSERT_TRUE(steal(&stolen, 1));
+  ASSERT_EQ(a, stolen);
+  ASSERT_TRUE(steal(&stolen, 1));
+  ASSERT_EQ(b, stolen);
+  ASSERT_FALSE(steal(&stolen, 1));
+  ASSERT_TRUE(deques[0]->isEmpty());
+}
+
+TEST_F(ExecutorTest, stealOtherBatchTest) {
+  mv_action *a = make_action(1, 0), *b = make_action(2, 0), *stolen;
+
+  // The peer is still running epoch 1, while this thread runs epoch 2.
+  epochs[1] = 1;
+  ASSERT_TRUE(deques[0]->Push(a));
+  ASSERT_FALSE(steal(&stolen, 2));
+
+  // The peer moved on to epoch 2 with an action of epoch 1 still on its
+  // deque, which is not part of this thread's batch.
+  epochs[0] = 1;
+  ASSERT_FALSE(steal(&stolen, 2));
+  ASSERT_TRUE(deques[0]->Pop(&stolen));
+  ASSERT_EQ(a, stolen);
+
+  // Once the peer runs epoch 2, its actions of epoch 2 are stolen.
+  ASSERT_TRUE(deques[0]->Push(b));
+  ASSERT_TRUE(steal(&stolen, 2));
+  ASSERT_EQ(b, stolen);
+}
+
+TEST_F(ExecutorTest, dependencyLatencyTest) {
+  mv_action *writer = make_action(1, 0), *reader = make_action(2, 0);
+  MVRecord version;
+  LatencyHistogram *latencies;
+
+  // The reader of epoch 2 runs its writer of epoch 1, whose batch started
+  // long before the reader's.
+  memset(&version, 0x0, sizeof(version));
+  version.writer = writer;
+  reader->__readset.push_back(CompositeKey(false, 0, 0));
+  reader->__readset[0].value = &version;
+  writer->start_time = rdtsc() - (1ULL << 40);
+  reader->start_time = rdtsc();
+  ASSERT_TRUE(process(reader));
+  ASSERT_EQ(SUBSTANTIATED, writer->__state);
+
+  // Each action is measured from its own batch's start.
+  latencies = exec->Latencies();
+  ASSERT_EQ(2U, latencies->Count());
+  ASSERT_GE(latencies->Percentile(100), 1ULL << 39);
+  ASSERT_LT(latencies->Percentile(0), 1ULL << 39);
+}
+
+TEST_F(ExecutorTest, snapshotLookupTest) {
+  static const uint32_t numKeys = 3*MV_LOOKUP_BATCH + 1;
+  MVIndexType types[2] = {MV_CHAINED_INDEX, MV_BUCKET_INDEX};
+  MVRecordAllocator *alloc;
+  MVTable *table;
+  mv_action *reader;
+  uint32_t i, t;
+
+  for (t = 0; t < 2; ++t) {
+    alloc = new(0) MVRecordAllocator(sizeof(MVRecord)*4*numKeys, 0, 0, 0, 0);
+    table = new MVTable(1);
+    table->AddPartition(0, new(0) MVTablePartition(numKeys, 0, alloc, 
+                                                   types[t]));
+    set_tables(&table);
+
+    // Every key has a version of epoch 1, and odd keys one of epoch 2.
+    for (i = 0; i < numKeys; ++i) {
+      CompositeKey k(true, 0, i);
+      table->WriteNewVersion(0, k, NULL, CREATE_MV_TIMESTAMP(1, i));
+      if (i % 2 == 1)
+        table->WriteNewVersion(0, k, NULL, CREATE_MV_TIMESTAMP(2, i));
+    }
+
+    // A snapshot read of epoch 2 sees the versions of epoch 1, across
+    // several lookup groups.
+    reader = make_action(2, 0);
+    reader->__readonly = true;
+    reader->__snapshot = true;
+    for (i = 0; i < numKeys; ++i) {
+      reader->__readset.push_back(CompositeKey(false, 0, i));
+      reader->__readset[i].threadId = 0;
+    }
+    ASSERT_TRUE(process(reader));
+    for (i = 0; i < numKeys; ++i) {
+      ASSERT_TRUE(reader->__readset[i].value != NULL);
+      ASSERT_EQ(i, reader->__readset[i].value->key);
+      ASSERT_EQ(CREATE_MV_TIMESTAMP(1, i), 
+                reader->__readset[i].value->createTimestamp);
+    }
+  }
+}
+
+class GarbageBinTest : public testing::Test {
+protected:
+  static const uint64_t queueSize = 4;
+  char queueBuf[queueSize*CACHE_LINE];
+  SimpleQueue<MVRecordList> *channel;
+  volatile uint32_t watermark;
+  GarbageBin *bin;
+
+  virtual void SetUp() {
+    GarbageBinConfig config;
+
+    memset(&config, 0x0, sizeof(config));
+    channel = new SimpleQueue<MVRecordList>(queueBuf, queueSize);
+    watermark = 0;
+    config.numCCThreads = 1;
+    config.numWorkers = 1;
+    config.numTables = 1;
+    config.lowWaterMarkPtr = &watermark;
+    config.ccChannels = &channel;
+    bin = new(0) GarbageBin(config);
+  }
+};
+
+TEST_F(GarbageBinTest, deferredLinkTest) {
+  MVRecord versions[3];
+  MVRecordList garbage;
+
+  // Superseded versions still link to the next key in their hash chains.
+  versions[0].link = &versions[2];
+  versions[1].link = &versions[2];
+  bin->AddMVRecord(0, &versions[0]);
+  bin->AddMVRecord(0, &versions[1]);
+
+  // Readers may walk the chains until the low watermark passes epoch 1.
+  bin->FinishEpoch(1);
+  bin->FinishEpoch(2);
+  ASSERT_EQ(&versions[2], versions[0].link);
+  ASSERT_EQ(&versions[2], versions[1].link);
+  ASSERT_FALSE(channel->Dequeue(&garbage));
+
+  watermark = 1;
+  bin->FinishEpoch(3);
+  ASSERT_TRUE(channel->Dequeue(&garbage));
+  ASSERT_EQ(2U, garbage.count);
+  ASSERT_EQ(&versions[0], garbage.head);
+  ASSERT_EQ(&versions[1], versions[0].allocLink);
+  ASSERT_EQ(&versions[1].allocLink, garbage.tail);
+}
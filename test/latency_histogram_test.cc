@@ -0,0 +1,78 @@
+#include "gtest/gtest.h"
+#include "latency_histogram.h"
+
+#include <sstream>
+
+class LatencyHistogramTest : public testing::Test {
+protected:
+  LatencyHistogram hist;
+};
+
+TEST_F(LatencyHistogramTest, emptyTest) {
+  ASSERT_EQ(0U, hist.Count());
+  ASSERT_EQ(0U, hist.Percentile(50));
+}
+
+TEST_F(LatencyHistogramTest, smallValuesExactTest) {
+  for (uint64_t i = 0; i < 2*LATENCY_SUB_BUCKETS; i++) {
+    hist.Record(i);
+  }
+  ASSERT_EQ(2U*LATENCY_SUB_BUCKETS, hist.Count());
+  ASSERT_EQ((uint64_t)LATENCY_SUB_BUCKETS, hist.Percentile(50));
+  ASSERT_EQ(2U*LATENCY_SUB_BUCKETS-1, hist.Percentile(100));
+}
+
+TEST_F(LatencyHistogramTest, relativeErrorTest) {
+  uint64_t values[] = {100, 1000, 12345, 1000000, 987654321, 1ULL<<40};
+  for (uint64_t value : values) {
+    LatencyHistogram single;
+    single.Record(value);
+    uint64_t found = single.Percentile(50);
+    uint64_t diff = found > value ? found - value : value - found;
+    ASSERT_LE(diff, value / LATENCY_SUB_BUCKETS);
+  }
+
+  // the largest values still fall into a bucket.
+  hist.Record(~0ULL);
+  ASSERT_EQ(1U, hist.Count());
+  ASSERT_GT(hist.Percentile(50), (~0ULL) - (~0ULL) / LATENCY_SUB_BUCKETS);
+}
+
+TEST_F(LatencyHistogramTest, percentileTest) {
+  // 990 fast values and 10 slow ones, p99 is still fast, p99.9 is slow.
+  for (int i = 0; i < 990; i++) {
+    hist.Record(1000);
+  }
+  for (int i = 0; i < 10; i++) {
+    hist.Record(1000000);
+  }
+  ASSERT_LT(hist.Percentile(50), 1100U);
+  ASSERT_LT(hist.Percentile(98.9), 1100U);
+  ASSERT_GT(hist.Percentile(99.9), 900000U);
+}
+
+TEST_F(LatencyHistogramTest, mergeResetTest) {
+  LatencyHistogram other;
+  for (int i = 0; i < 100; i++) {
+    hist.Record(10);
+    other.Record(1000000);
+  }
+  hist.Merge(other);
+  ASSERT_EQ(200U, hist.Count());
+  ASSERT_EQ(10U, hist.Percentile(25));
+  ASSERT_GT(hist.Percentile(75), 900000U);
+
+  hist.Reset();
+  ASSERT_EQ(0U, hist.Count());
+  ASSERT_EQ(0U, hist.Percentile(99));
+}
+
+TEST_F(LatencyHistogramTest, writePercentilesTest) {
+  std::ostringstream out;
+  for (int i = 0; i < 100; i++) {
+    hist.Record(0);
+  }
+  hist.WritePercentiles(out, "arrival_");
+  ASSERT_EQ("arrival_p50:0 arrival_p90:0 arrival_p99:0 arrival_p99.9:0 ",
+            out.str());
+}
@@ -0,0 +1,169 @@
+#include "gtest/gtest.h"
+#include "lock_manager.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+// NOTE:
+//    Every test runs with both the request list and the per-key header
+//    layouts. The table has a single bucket, so all keys share it.
+
+class LockManagerTableTest : public testing::TestWithParam<bool> {
+protected:
+  uint32_t tableSize = 1;
+  std::shared_ptr<LockManagerTable> table;
+  std::shared_ptr<locking_action> txns[3];
+
+  virtual void SetUp() {
+    LockManagerConfig config = {1, &tableSize, 0, 0, GetParam()};
+    table = std::make_shared<LockManagerTable>(config);
+    for (int i = 0; i < 3; i++) {
+      txns[i] = std::make_shared<locking_action>((txn*)NULL);
+    }
+  }
+
+  locking_key make_key(uint64_t key, bool is_write, int txn) {
+    locking_key k(key, 0, is_write);
+    k.dependency = txns[txn].get();
+    return k;
+  }
+};
+
+TEST_P(LockManagerTableTest, sharedReadTest) {
+  locking_key r1 = make_key(1, false, 0);
+  locking_key r2 = make_key(1, false, 1);
+  locking_key w = make_key(1, true, 2);
+
+  // readers share the lock, the writer waits for both of them.
+  ASSERT_TRUE(table->Lock(&r1));
+  ASSERT_TRUE(table->Lock(&r2));
+  ASSERT_FALSE(table->Lock(&w));
+  table->Unlock(&r1);
+  ASSERT_FALSE(w.is_held);
+  table->Unlock(&r2);
+  ASSERT_TRUE(w.is_held);
+  table->Unlock(&w);
+}
+
+TEST_P(LockManagerTableTest, writerPassTest) {
+  locking_key w = make_key(1, true, 0);
+  locking_key r1 = make_key(1, false, 1);
+  locking_key r2 = make_key(1, false, 2);
+
+  // releasing the write lock grants all of the waiting readers.
+  ASSERT_TRUE(table->Lock(&w));
+  ASSERT_FALSE(table->Lock(&r1));
+  ASSERT_FALSE(table->Lock(&r2));
+  table->Unlock(&w);
+  ASSERT_TRUE(r1.is_held);
+  ASSERT_TRUE(r2.is_held);
+  table->Unlock(&r1);
+  table->Unlock(&r2);
+}
+
+TEST_P(LockManagerTableTest, distinctKeysTest) {
+  locking_key w1 = make_key(1, true, 0);
+  locking_key w2 = make_key(2, true, 1);
+  locking_key w3 = make_key(1, true, 2);
+
+  // keys in the same bucket don't conflict with each other.
+  ASSERT_TRUE(table->Lock(&w1));
+  ASSERT_TRUE(table->Lock(&w2));
+  ASSERT_FALSE(table->Lock(&w3));
+  table->Unlock(&w2);
+  ASSERT_FALSE(w3.is_held);
+  table->Unlock(&w1);
+  ASSERT_TRUE(w3.is_held);
+  table->Unlock(&w3);
+
+  // the bucket is empty again, and its headers can be reused.
+  locking_key w4 = make_key(2, true, 0);
+  ASSERT_TRUE(table->Lock(&w4));
+  table->Unlock(&w4);
+}
+
+TEST_P(LockManagerTableTest, noWaitTest) {
+  locking_key w = make_key(1, true, 0);
+  locking_key r = make_key(1, false, 1);
+
+  // a denied request isn't queued, and can be retried once the key is free.
+  ASSERT_EQ(LOCK_GRANTED, table->TryLock(&w, LOCK_NO_WAIT));
+  ASSERT_EQ(LOCK_DENIED, table->TryLock(&r, LOCK_NO_WAIT));
+  ASSERT_FALSE(r.is_held);
+  table->Unlock(&w);
+  ASSERT_EQ(LOCK_GRANTED, table->TryLock(&r, LOCK_NO_WAIT));
+  table->Unlock(&r);
+}
+
+TEST_P(LockManagerTableTest, waitDieTest) {
+  LockManagerConfig config = {1, &tableSize, 0, 0, GetParam(), LOCK_WAIT_DIE};
+  LockManager mgr(config);
+  for (int i = 0; i < 3; i++) {
+    mgr.Begin(txns[i].get());
+  }
+  locking_key w0 = make_key(1, true, 0);
+  locking_key w1 = make_key(1, true, 1);
+  locking_key w2 = make_key(1, true, 2);
+
+  // younger requesters die, older ones wait for the holder.
+  ASSERT_EQ(LOCK_GRANTED, table->TryLock(&w1, LOCK_WAIT_DIE));
+  ASSERT_EQ(LOCK_DENIED, table->TryLock(&w2, LOCK_WAIT_DIE));
+  ASSERT_EQ(LOCK_QUEUED, table->TryLock(&w0, LOCK_WAIT_DIE));
+  table->Unlock(&w1);
+  ASSERT_TRUE(w0.is_held);
+  table->Unlock(&w0);
+}
+
+TEST_P(LockManagerTableTest, earlyReleaseTest) {
+  // only the per-key header layout can release early.
+  if (!GetParam()) {
+    return;
+  }
+  locking_key w0 = make_key(1, true, 0);
+  locking_key w1 = make_key(1, true, 1);
+  locking_key w2 = make_key(1, true, 2);
+
+  // an early release hands the lock on like a regular one, and the header
+  // outlives the uncommitted releaser.
+  ASSERT_TRUE(table->Lock(&w0));
+  ASSERT_FALSE(table->Lock(&w1));
+  table->Unlock(&w0, true);
+  ASSERT_TRUE(w1.is_held);
+  table->Unlock(&w1, true);
+  ASSERT_TRUE(table->Lock(&w2));
+  ASSERT_TRUE(w2.header != NULL);
+  table->Unlock(&w2);
+}
+
+TEST_P(LockManagerTableTest, mcsLatchTest) {
+  const int num_threads = 4;
+  const int iters = 2000;
+  LockManagerConfig config = {1, &tableSize, 0, 0, GetParam(), LOCK_NO_WAIT,
+                              true};
+  LockManagerTable mcs_table(config);
+  std::vector<std::thread> threads;
+
+  // threads lock distinct keys, which all share the single latched bucket.
+  for (int t = 0; t < num_threads; t++) {
+    threads.push_back(std::thread([&mcs_table, t](){
+      locking_action action((txn*)NULL);
+      for (int i = 0; i < iters; i++) {
+        locking_key k(t, 0, i % 2 == 0);
+        k.dependency = &action;
+        ASSERT_EQ(LOCK_GRANTED, mcs_table.TryLock(&k, LOCK_NO_WAIT));
+        mcs_table.Unlock(&k);
+      }
+    }));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  // the latch was handed back, and no lock is left behind.
+  locking_key w = make_key(0, true, 0);
+  ASSERT_EQ(LOCK_GRANTED, mcs_table.TryLock(&w, LOCK_NO_WAIT));
+  mcs_table.Unlock(&w);
+}
+
+INSTANTIATE_TEST_CASE_P(Layouts, LockManagerTableTest, testing::Bool());
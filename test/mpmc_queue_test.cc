@@ -0,0 +1,128 @@
+#include "gtest/gtest.h"
+#include "concurrent_queue.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+
+// NOTE:
+//    All of the tests of MPMCQueues are done using integers for simplicity.
+//    Every test runs with both compact and cache line padded slots.
+
+class MPMCQueueTest : public testing::TestWithParam<bool> {
+protected:
+  static const uint64_t size = 128;
+  std::vector<char> values;
+  std::shared_ptr<MPMCQueue<int>> queue;
+
+  virtual void SetUp() {
+    values.resize(size * MPMCQueue<int>::SlotSize(GetParam()));
+    queue = std::make_shared<MPMCQueue<int>>(values.data(), size, GetParam());
+  }
+};
+
+TEST_P(MPMCQueueTest, constructorTest) {
+  int val;
+  ASSERT_TRUE(queue->isEmpty());
+  ASSERT_FALSE(queue->Dequeue(&val));
+  if (GetParam()) {
+    ASSERT_LT(MPMCQueue<int>::SlotSize(true), (uint64_t)CACHE_LINE);
+  } else {
+    ASSERT_EQ((uint64_t)CACHE_LINE, MPMCQueue<int>::SlotSize(false));
+  }
+}
+
+TEST_P(MPMCQueueTest, fifoTest) {
+  int val;
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(queue->Enqueue(i));
+  }
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(queue->Dequeue(&val));
+    ASSERT_EQ(i, val);
+  }
+  ASSERT_TRUE(queue->isEmpty());
+}
+
+TEST_P(MPMCQueueTest, fullTest) {
+  int val;
+  for (int i = 0; i < (int)size; i++) {
+    ASSERT_TRUE(queue->Enqueue(i));
+  }
+  ASSERT_FALSE(queue->Enqueue(size));
+
+  // dequeueing an element frees a slot, and the ring wraps around.
+  ASSERT_TRUE(queue->Dequeue(&val));
+  ASSERT_EQ(0, val);
+  ASSERT_TRUE(queue->Enqueue(size));
+  for (int i = 1; i <= (int)size; i++) {
+    ASSERT_EQ(i, queue->DequeueBlocking());
+  }
+  ASSERT_FALSE(queue->Dequeue(&val));
+}
+
+TEST_P(MPMCQueueTest, batchTest) {
+  int in[2*size], out[2*size];
+  for (int i = 0; i < (int)(2*size); i++) {
+    in[i] = i;
+  }
+
+  // batches are cut short by the free space, and by the elements available.
+  ASSERT_EQ(100U, queue->EnqueueMany(in, 100));
+  ASSERT_EQ(size-100, queue->EnqueueMany(&in[100], 100));
+  ASSERT_EQ(0U, queue->EnqueueMany(in, 1));
+  ASSERT_EQ(50U, queue->DequeueMany(out, 50));
+  ASSERT_EQ(size-50, queue->DequeueMany(&out[50], 2*size));
+  ASSERT_EQ(0U, queue->DequeueMany(out, 1));
+  for (int i = 0; i < (int)size; i++) {
+    ASSERT_EQ(i, out[i]);
+  }
+}
+
+TEST_P(MPMCQueueTest, concurrentTest) {
+  const int producers = 3;
+  const int consumers = 3;
+  const int per_producer = 10000;
+  std::vector<std::atomic<int>> taken(producers * per_producer);
+  std::atomic<int> num_taken(0);
+  std::vector<std::thread> threads;
+
+  for (auto& t : taken) t = 0;
+  for (int p = 0; p < producers; p++) {
+    threads.push_back(std::thread([this, p](){
+      int batch[7];
+      int next = p * per_producer;
+      int end = next + per_producer;
+      while (next < end) {
+        int n = 0;
+        while (n < 7 && next + n < end) {
+          batch[n] = next + n;
+          n++;
+        }
+        next += queue->EnqueueMany(batch, n);
+      }
+    }));
+  }
+  for (int c = 0; c < consumers; c++) {
+    threads.push_back(std::thread([this, &taken, &num_taken](){
+      int batch[5];
+      while (num_taken < producers * per_producer) {
+        uint32_t n = queue->DequeueMany(batch, 5);
+        for (uint32_t i = 0; i < n; i++) {
+          taken[batch[i]]++;
+        }
+        num_taken += n;
+      }
+    }));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  // every element is taken exactly once.
+  for (auto& t : taken) {
+    ASSERT_EQ(1, t);
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(SlotLayouts, MPMCQueueTest, testing::Bool());
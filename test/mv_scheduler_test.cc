@@ -0,0 +1,88 @@
+#include "gtest/gtest.h"
+#include "preprocessor.h"
+
+#include <cstring>
+
+class MVSchedulerTest : public testing::Test {
+protected:
+  size_t partitionSizes[1];
+  volatile uint32_t watermark;
+  MVScheduler *sched;
+
+  virtual void SetUp() {
+    MVSchedulerConfig config;
+
+    memset(&config, 0x0, sizeof(config));
+    partitionSizes[0] = 64;
+    watermark = 0;
+    config.allocatorSize = sizeof(MVRecord)*1024;
+    config.numTables = 1;
+    config.tblPartitionSizes = partitionSizes;
+    config.indexType = MV_CHAINED_INDEX;
+    config.lowWaterMarkPtr = &watermark;
+    sched = new(0) MVScheduler(config);
+  }
+
+  // Insert a version of key 0 without trimming its chain.
+  MVRecord* write(uint32_t epoch, uint32_t counter) {
+    CompositeKey k(true, 0, 0);
+    sched->partitions[0]->WriteNewVersion(k, NULL, 
+                                          CREATE_MV_TIMESTAMP(epoch, counter));
+    return k.value;
+  }
+
+  void trim(MVRecord *version, uint32_t low_watermark) {
+    watermark = low_watermark;
+    sched->ReadLowWatermark();
+    sched->TrimChain(version);
+  }
+
+  uint32_t chain_length(MVRecord *version) {
+    uint32_t ret = 0;
+    for (; version != NULL; version = version->recordLink)
+      ret += 1;
+    return ret;
+  }
+};
+
+TEST_F(MVSchedulerTest, trimChainTest) {
+  MVRecord *versions[4][3];
+  uint32_t i, j;
+
+  for (i = 0; i < 4; ++i)
+    for (j = 0; j < 3; ++j)
+      versions[i][j] = write(i + 1, j);
+
+  // Versions of an epoch all lead to the last version of the epoch before.
+  ASSERT_EQ(versions[1][2], versions[2][0]->epoch_ancestor);
+  ASSERT_EQ(versions[1][2], versions[2][2]->epoch_ancestor);
+
+  // Epochs 3 and 4 are in flight, the trim hops from epoch 4 straight to the
+  // newest version of epoch 2, skipping the rest of epoch 3.
+  MVRecord *newest = write(5, 0);
+  trim(newest, 2);
+  ASSERT_EQ(versions[1][2], versions[2][0]->recordLink);
+  ASSERT_TRUE(versions[1][2]->recordLink == NULL);
+  ASSERT_TRUE(versions[1][2]->epoch_ancestor == NULL);
+  ASSERT_EQ(8U, chain_length(newest));
+
+  // Versions newer than the watermark keep their links.
+  ASSERT_EQ(versions[2][2], versions[3][0]->epoch_ancestor);
+  ASSERT_EQ(versions[3][1], versions[3][2]->recordLink);
+}
+
+TEST_F(MVSchedulerTest, trimWithinEpochTest) {
+  MVRecord *first = write(1, 0);
+  MVRecord *second = write(1, 1);
+
+  // Nothing is at or below the watermark, the chain is left alone.
+  trim(second, 0);
+  ASSERT_EQ(first, second->recordLink);
+
+  // The newest version at the watermark survives, older ones are cut.
+  MVRecord *newest = write(2, 0);
+  trim(newest, 1);
+  ASSERT_EQ(second, newest->recordLink);
+  ASSERT_TRUE(second->recordLink == NULL);
+  ASSERT_EQ(2U, chain_length(newest));
+}
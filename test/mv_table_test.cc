@@ -0,0 +1,93 @@
+#include "gtest/gtest.h"
+#include "mv_table.h"
+
+#include <vector>
+
+class MVTableTest : public testing::Test {
+protected:
+  MVRecordAllocator *alloc;
+
+  virtual void SetUp() {
+    alloc = new(0) MVRecordAllocator(sizeof(MVRecord)*1024, 0, 0, 0, 0);
+  }
+
+  MVTablePartition* make_partition(uint64_t size) {
+    return new(0) MVTablePartition(size, 0, alloc, MV_BUCKET_INDEX);
+  }
+
+  void write(MVTablePartition *part, uint64_t key, uint32_t epoch) {
+    CompositeKey k(true, 0, key);
+    ASSERT_TRUE(part->WriteNewVersion(k, NULL, CREATE_MV_TIMESTAMP(epoch, 0)));
+    ASSERT_EQ(key, k.value->key);
+  }
+
+  MVRecord* lookup(MVTablePartition *part, uint64_t key, uint32_t epoch) {
+    CompositeKey k(false, 0, key);
+    return part->GetMVRecord(k, CREATE_MV_TIMESTAMP(epoch, 0));
+  }
+
+  // The first bucket the key probes in a partition with numBuckets buckets.
+  uint64_t home_bucket(uint64_t key, uint64_t numBuckets) {
+    CompositeKey k(false, 0, key);
+    return CompositeKey::Hash(&k) % numBuckets;
+  }
+};
+
+TEST_F(MVTableTest, insertLookupTest) {
+  MVTablePartition *part = make_partition(64);
+  uint64_t i;
+
+  for (i = 0; i < 64; ++i)
+    write(part, i, 1);
+  for (i = 0; i < 64; ++i) {
+    MVRecord *rec = lookup(part, i, 1);
+    ASSERT_TRUE(rec != NULL);
+    ASSERT_EQ(i, rec->key);
+  }
+  ASSERT_TRUE(lookup(part, 1000, 1) == NULL);
+
+  // A key's versions share its entry, lookups pick by version.
+  write(part, 5, 2);
+  ASSERT_EQ(CREATE_MV_TIMESTAMP(2, 0), lookup(part, 5, 2)->createTimestamp);
+  ASSERT_EQ(CREATE_MV_TIMESTAMP(1, 0), lookup(part, 5, 1)->createTimestamp);
+}
+
+TEST_F(MVTableTest, wraparoundTest) {
+  // Size 8 gives 4 buckets of MV_BUCKET_ENTRIES keys each.
+  const uint64_t numBuckets = 4;
+  MVTablePartition *part = make_partition(8);
+  std::vector<uint64_t> last, first;
+  uint64_t key;
+
+  // Overflow the last bucket, the extra keys wrap around to the first one.
+  for (key = 0; last.size() < MV_BUCKET_ENTRIES + 2; ++key) {
+    if (home_bucket(key, numBuckets) == numBuckets - 1)
+      last.push_back(key);
+    else if (home_bucket(key, numBuckets) == 0 && first.size() < 2)
+      first.push_back(key);
+  }
+  for (auto k : last)
+    write(part, k, 1);
+  for (auto k : first)
+    write(part, k, 1);
+
+  // The first bucket's own keys probe past the keys which wrapped into it.
+  for (auto k : last)
+    ASSERT_EQ(k, lookup(part, k, 1)->key);
+  for (auto k : first)
+    ASSERT_EQ(k, lookup(part, k, 1)->key);
+}
+
+TEST_F(MVTableTest, fullTest) {
+  MVTablePartition *part = make_partition(8);
+  uint64_t i;
+
+  // The index holds twice the partition's size.
+  for (i = 0; i < 2*8; ++i)
+    write(part, i, 1);
+  for (i = 0; i < 2*8; ++i)
+    ASSERT_EQ(i, lookup(part, i, 1)->key);
+
+  // A missing key probes every bucket, and isn't found.
+  ASSERT_TRUE(lookup(part, 100, 1) == NULL);
+}
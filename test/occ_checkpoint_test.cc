@@ -0,0 +1,57 @@
+#include "gtest/gtest.h"
+#include "occ_checkpoint.h"
+#include "occ_action.h"
+
+#include <cstdio>
+#include <unistd.h>
+
+class OCCCheckpointTest : public testing::Test {
+protected:
+  static const uint64_t numRecords = 1000;
+  static const uint64_t valueSz = OCC_RECORD_SIZE(sizeof(uint64_t));
+  char path[32];
+
+  Table* make_table() {
+    TableConfig conf = {0, numRecords, 0, 0, numRecords, valueSz, 0};
+    return new(0) Table(conf);
+  }
+
+  virtual void SetUp() {
+    int fd;
+    strcpy(path, "/tmp/occ_ckpt_XXXXXX");
+    fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+  }
+
+  virtual void TearDown() {
+    unlink(path);
+  }
+};
+
+TEST_F(OCCCheckpointTest, roundTripTest) {
+  Table *table = make_table();
+  volatile uint32_t epoch = 3;
+  uint64_t i, record[2];
+
+  for (i = 0; i < numRecords; ++i) {
+    record[0] = CREATE_TID(2, i);
+    record[1] = i*7;
+    table->Put(i, record);
+  }
+
+  OCCCheckpointerConfig conf = {0, path, &table, 1, &epoch};
+  OCCCheckpointer *checkpointer = new(0) OCCCheckpointer(conf);
+  checkpointer->Run();
+  checkpointer->Join();
+
+  // Load with a thread count that doesn't divide the partitions evenly.
+  Table *restored = make_table();
+  ASSERT_EQ(3U, occ_load_checkpoint(path, &restored, 1, 3));
+  for (i = 0; i < numRecords; ++i) {
+    uint64_t *value = (uint64_t*)restored->Get(i);
+    ASSERT_EQ(CREATE_TID(2, i), value[0]);
+    ASSERT_EQ(i*7, value[1]);
+    ASSERT_EQ(table->BucketIndex(i), restored->BucketIndex(i));
+  }
+}
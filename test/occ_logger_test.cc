@@ -0,0 +1,117 @@
+#include "gtest/gtest.h"
+#include "occ.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+static const uint32_t recordLen = 16;
+
+class OCCLoggerTest : public testing::Test {
+protected:
+  static const uint64_t logSize = 1 << 16;
+  char path[32];
+  int fd;
+  volatile uint32_t durable;
+  occ_log_channel *channels[2];
+  OCCLogger *logger;
+  std::vector<occ_log_header> written;
+
+  virtual void SetUp() {
+    strcpy(path, "/tmp/occ_log_XXXXXX");
+    fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    durable = 0;
+    channels[0] = OCCLogger::CreateChannel(logSize, 0);
+    channels[1] = OCCLogger::CreateChannel(logSize, 0);
+    OCCLoggerConfig conf = {0, fd, channels, 2, &durable};
+    logger = new(0) OCCLogger(conf);
+  }
+
+  virtual void TearDown() {
+    close(fd);
+    unlink(path);
+  }
+
+  // Hand the logger a buffer of entries from the given epoch, the way a 
+  // worker does before it moves on to the next one.
+  void log_epoch(occ_log_channel *channel, uint32_t epoch, uint64_t first_key,
+                 uint32_t num_entries) {
+    occ_log_buffer buf = channel->free->DequeueBlocking();
+    occ_log_header header;
+    uint32_t i;
+
+    buf.epoch = epoch;
+    for (i = 0; i < num_entries; ++i) {
+      header.table_id = i % 2;
+      header.key = first_key + i;
+      header.tid = CREATE_TID(epoch, i);
+      header.record_len = recordLen;
+      memcpy(&buf.data[buf.size], &header, sizeof(header));
+      memset(&buf.data[buf.size + sizeof(header)], (int)header.key, recordLen);
+      buf.size += sizeof(header) + recordLen;
+      written.push_back(header);
+    }
+    channel->full->EnqueueBlocking(buf);
+    channel->epoch = epoch + 1;
+  }
+};
+
+TEST_F(OCCLoggerTest, durableEpochTest) {
+  log_epoch(channels[0], 1, 0, 10);
+  log_epoch(channels[0], 2, 10, 10);
+  log_epoch(channels[0], 4, 20, 10);
+  log_epoch(channels[1], 1, 100, 5);
+  ASSERT_EQ(5U, channels[0]->epoch);
+  ASSERT_EQ(2U, channels[1]->epoch);
+
+  // The slower channel is still in epoch 2, so only epoch 1 is durable.
+  ASSERT_TRUE(logger->Sync());
+  ASSERT_EQ(1U, durable);
+  ASSERT_FALSE(logger->Sync());
+  ASSERT_EQ(1U, durable);
+
+  // Every buffer was given back.
+  occ_log_buffer buf;
+  uint32_t num_free = 0;
+  while (channels[0]->free->Dequeue(&buf)) {
+    ASSERT_EQ(0U, buf.size);
+    num_free += 1;
+  }
+  ASSERT_EQ((uint32_t)OCC_LOG_BUFFERS, num_free);
+
+  // An idle worker moves its channel without logging anything.
+  channels[1]->epoch = 4;
+  ASSERT_TRUE(logger->Sync());
+  ASSERT_EQ(3U, durable);
+}
+
+TEST_F(OCCLoggerTest, readBackTest) {
+  log_epoch(channels[0], 1, 0, 50);
+  log_epoch(channels[1], 1, 1000, 30);
+  log_epoch(channels[1], 2, 2000, 30);
+  channels[0]->epoch = 3;
+  ASSERT_TRUE(logger->Sync());
+  ASSERT_EQ(2U, durable);
+
+  // Channels are drained in order, and each channel's buffers in FIFO order.
+  int rfd = open(path, O_RDONLY);
+  ASSERT_GE(rfd, 0);
+  occ_log_header header;
+  char value[recordLen], expected[recordLen];
+  uint32_t i;
+  for (i = 0; i < written.size(); ++i) {
+    ASSERT_EQ((ssize_t)sizeof(header), read(rfd, &header, sizeof(header)));
+    ASSERT_EQ(written[i].table_id, header.table_id);
+    ASSERT_EQ(written[i].key, header.key);
+    ASSERT_EQ(written[i].tid, header.tid);
+    ASSERT_EQ(recordLen, header.record_len);
+    ASSERT_EQ((ssize_t)recordLen, read(rfd, value, recordLen));
+    memset(expected, (int)header.key, recordLen);
+    ASSERT_EQ(0, memcmp(expected, value, recordLen));
+  }
+  ASSERT_EQ(0, read(rfd, &header, sizeof(header)));
+  close(rfd);
+}
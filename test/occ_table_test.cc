@@ -0,0 +1,54 @@
+#include "gtest/gtest.h"
+#include "occ_table.h"
+#include "occ_action.h"
+
+class OCCTableTest : public testing::Test {
+protected:
+  OCCTable* make_table(uint64_t num_keys, uint64_t value_sz) {
+    TableConfig conf = {0, num_keys, 0, 0, num_keys, value_sz, 0};
+    return new(0) OCCTable(conf);
+  }
+};
+
+TEST_F(OCCTableTest, putGetTest) {
+  OCCTable *table = make_table(1000, OCC_RECORD_SIZE(sizeof(uint64_t)));
+  uint64_t i, record[2];
+
+  for (i = 0; i < 1000; ++i) {
+    record[0] = CREATE_TID(1, i);
+    record[1] = i*3;
+    table->Put(i, record);
+  }
+  table->SetInit();
+  for (i = 0; i < 1000; ++i) {
+    uint64_t *value = (uint64_t*)table->Get(i);
+    ASSERT_EQ(CREATE_TID(1, i), *RECORD_TID_PTR(value));
+    ASSERT_EQ(i*3, *(uint64_t*)RECORD_VALUE_PTR(value));
+  }
+}
+
+TEST_F(OCCTableTest, getAlwaysTest) {
+  OCCTable *table = make_table(16, OCC_RECORD_SIZE(sizeof(uint64_t)));
+
+  // Before SetInit, GetAlways inserts zeroed records, once per key.
+  void *first = table->GetAlways(5);
+  ASSERT_EQ(0U, *RECORD_TID_PTR(first));
+  ASSERT_EQ(first, table->GetAlways(5));
+  table->SetInit();
+  ASSERT_EQ(first, table->Get(5));
+}
+
+TEST_F(OCCTableTest, slotLayoutTest) {
+  OCCTable *small = make_table(64, OCC_RECORD_SIZE(sizeof(uint64_t)));
+  OCCTable *large = make_table(64, OCC_RECORD_SIZE(1000));
+  uint64_t i, addr;
+
+  // Small records never straddle a line, large ones start a line.
+  for (i = 0; i < 64; ++i) {
+    addr = (uint64_t)small->GetAlways(i) - sizeof(uint64_t);
+    ASSERT_EQ(addr / CACHE_LINE,
+              (addr + 3*sizeof(uint64_t) - 1) / CACHE_LINE);
+    addr = (uint64_t)large->GetAlways(i) - sizeof(uint64_t);
+    ASSERT_EQ(0U, addr % CACHE_LINE);
+  }
+}
@@ -0,0 +1,34 @@
+#include "gtest/gtest.h"
+#include "occ_temperature.h"
+
+class OCCTemperatureTest : public testing::Test {
+protected:
+  OCCTemperature *temperature;
+
+  virtual void SetUp() {
+    temperature = new(0) OCCTemperature(3);
+  }
+};
+
+TEST_F(OCCTemperatureTest, thresholdTest) {
+  temperature->Heat(1, 0, 10);
+  temperature->Heat(1, 0, 10);
+  ASSERT_FALSE(temperature->IsHot(1, 0, 10));
+  temperature->Heat(2, 0, 10);
+  ASSERT_TRUE(temperature->IsHot(2, 0, 10));
+  ASSERT_FALSE(temperature->IsHot(2, 1, 10));
+  ASSERT_FALSE(temperature->IsHot(2, 0, 11));
+}
+
+TEST_F(OCCTemperatureTest, decayTest) {
+  uint32_t i;
+
+  for (i = 0; i < 10; ++i)
+    temperature->Heat(1, 0, 10);
+  ASSERT_TRUE(temperature->IsHot(1 + OCC_TEMP_WINDOW, 0, 10));
+  ASSERT_FALSE(temperature->IsHot(2 + OCC_TEMP_WINDOW, 0, 10));
+
+  // A stale counter starts over rather than staying hot.
+  temperature->Heat(2 + OCC_TEMP_WINDOW, 0, 10);
+  ASSERT_FALSE(temperature->IsHot(2 + OCC_TEMP_WINDOW, 0, 10));
+}
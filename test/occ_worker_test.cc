@@ -0,0 +1,245 @@
+#include "gtest/gtest.h"
+#include "occ.h"
+#include "test/test_txn.h"
+
+#include <cstring>
+#include <thread>
+#include <atomic>
+
+class OCCWorkerTest : public testing::Test {
+protected:
+  static const uint64_t numRecords = 100;
+  static const uint64_t valueSz = OCC_RECORD_SIZE(2*sizeof(uint64_t));
+  Table *tables[1];
+  uint32_t record_sizes[1];
+  volatile uint32_t epoch;
+  volatile uint32_t durable;
+  occ_log_channel *channel;
+  OCCWorker *worker;
+
+  virtual void SetUp() {
+    TableConfig table_conf = {0, numRecords, 0, 0, numRecords, valueSz, 0};
+    tables[0] = new(0) Table(table_conf);
+    record_sizes[0] = valueSz;
+    epoch = 1;
+    durable = 0;
+    channel = OCCLogger::CreateChannel(1 << 16, 0);
+
+    OCCWorkerConfig conf;
+    memset(&conf, 0x0, sizeof(conf));
+    conf.tables = tables;
+    conf.epoch_ptr = &epoch;
+    conf.num_tables = 1;
+    conf.log = channel;
+    conf.durable_epoch = &durable;
+    RecordBuffersConfig rb_conf = {1, record_sizes, 4, 0};
+    worker = new(0) OCCWorker(conf, rb_conf);
+    worker->logging = true;
+  }
+
+  OCCAction* make_writer(uint64_t key, uint64_t tid, uint64_t *record) {
+    OCCAction *action = new OCCAction(new TestTxn());
+    action->add_write_key(0, key, false);
+    action->writeset[0].value = record;
+    action->tid = tid;
+    return action;
+  }
+
+  void log_writes(OCCAction *action, uint32_t epoch) {
+    worker->LogWrites(action, epoch);
+  }
+
+  void ack_commit(uint32_t epoch) {
+    worker->AckCommit(epoch);
+  }
+
+  void txn_boundary() {
+    worker->TxnBoundary();
+  }
+
+  // A worker which doesn't log, and advances the shared epoch from deadline.
+  OCCWorker* make_epoch_worker(volatile uint64_t *deadline, 
+                               uint64_t threshold) {
+    OCCWorkerConfig conf = worker->config;
+    conf.log = NULL;
+    conf.epoch_deadline = deadline;
+    conf.epoch_threshold = threshold;
+    RecordBuffersConfig rb_conf = {1, record_sizes, 4, 0};
+    return new(0) OCCWorker(conf, rb_conf);
+  }
+
+  void txn_boundary(OCCWorker *w) {
+    w->TxnBoundary();
+  }
+
+  // Abort the action on key, with the given number of aborts so far.
+  void schedule_retry(OCCAction *action, uint64_t key, uint32_t num_aborts) {
+    action->num_aborts = num_aborts;
+    worker->ScheduleRetry(action,
+                          occ_validation_exception(VALIDATION_ERR, 0, key));
+  }
+
+  bool deferred(OCCAction *action) {
+    return worker->Deferred(action);
+  }
+
+  void set_backoff(uint64_t backoff) {
+    worker->config.backoff = backoff;
+  }
+
+  uint64_t& retry_at(OCCAction *action) {
+    return action->retry_at;
+  }
+
+  volatile uint64_t* conflict_ptr(OCCAction *action) {
+    return action->conflict_ptr;
+  }
+};
+
+TEST_F(OCCWorkerTest, logLayoutTest) {
+  uint64_t record[3] = {0, 11, 22};
+  OCCAction *action = make_writer(7, CREATE_TID(1, 3), record);
+  occ_log_buffer buf;
+
+  log_writes(action, 1);
+  ASSERT_EQ(1U, channel->epoch);
+  ASSERT_FALSE(channel->full->Dequeue(&buf));
+
+  // Moving on to the next epoch hands the buffer to the logger.
+  epoch = 2;
+  txn_boundary();
+  ASSERT_EQ(2U, channel->epoch);
+  ASSERT_TRUE(channel->full->Dequeue(&buf));
+  ASSERT_EQ(1U, buf.epoch);
+  ASSERT_EQ(sizeof(occ_log_header) + 2*sizeof(uint64_t), buf.size);
+
+  occ_log_header *header = (occ_log_header*)buf.data;
+  ASSERT_EQ(0U, header->table_id);
+  ASSERT_EQ(7U, header->key);
+  ASSERT_EQ(CREATE_TID(1, 3), header->tid);
+  ASSERT_EQ(2*sizeof(uint64_t), header->record_len);
+  uint64_t *value = (uint64_t*)&buf.data[sizeof(occ_log_header)];
+  ASSERT_EQ(11U, value[0]);
+  ASSERT_EQ(22U, value[1]);
+}
+
+TEST_F(OCCWorkerTest, idlePublishTest) {
+  occ_log_buffer buf;
+
+  // A worker which commits nothing still moves its channel along.
+  epoch = 5;
+  txn_boundary();
+  ASSERT_EQ(5U, channel->epoch);
+  ASSERT_FALSE(channel->full->Dequeue(&buf));
+}
+
+TEST_F(OCCWorkerTest, ackCommitTest) {
+  ack_commit(2);
+  ack_commit(2);
+  ack_commit(3);
+  ack_commit(5);
+  ASSERT_EQ(0U, worker->NumDurable());
+
+  durable = 2;
+  ack_commit(5);
+  ASSERT_EQ(2U, worker->NumDurable());
+
+  // Idle workers acknowledge too.
+  durable = 4;
+  txn_boundary();
+  ASSERT_EQ(3U, worker->NumDurable());
+  durable = 5;
+  txn_boundary();
+  ASSERT_EQ(5U, worker->NumDurable());
+}
+
+TEST_F(OCCWorkerTest, backoffWindowTest) {
+  const uint64_t base = 1 << 10;
+  uint64_t record[3] = {CREATE_TID(1, 0), 0, 0};
+  uint64_t before, after, delay, min_wait, max_wait;
+  uint32_t num_aborts, i, shift;
+  OCCAction *action = make_writer(3, 0, record);
+
+  tables[0]->Put(3, record);
+  set_backoff(base);
+  for (num_aborts = 1; num_aborts < OCC_BACKOFF_MAX_SHIFT + 4; ++num_aborts) {
+    shift = num_aborts - 1;
+    if (shift > OCC_BACKOFF_MAX_SHIFT)
+      shift = OCC_BACKOFF_MAX_SHIFT;
+    delay = base << shift;
+
+    // Retries are spread over the second half of the window.
+    min_wait = delay;
+    max_wait = 0;
+    for (i = 0; i < 100; ++i) {
+      before = rdtsc();
+      schedule_retry(action, 3, num_aborts);
+      after = rdtsc();
+      ASSERT_GE(retry_at(action), before + delay/2);
+      ASSERT_LE(retry_at(action), after + delay);
+      if (retry_at(action) - after < min_wait)
+        min_wait = retry_at(action) - after;
+      if (retry_at(action) - before > max_wait)
+        max_wait = retry_at(action) - before;
+    }
+    ASSERT_LT(min_wait + delay/8, max_wait);
+
+    // The record isn't locked, so there's no TID to wait out.
+    ASSERT_TRUE(conflict_ptr(action) == NULL);
+  }
+}
+
+TEST_F(OCCWorkerTest, deferredTest) {
+  uint64_t record[3] = {CREATE_TID(1, 0) | 1, 0, 0};
+  OCCAction *action = make_writer(4, 0, record);
+  volatile uint64_t *tid_ptr;
+
+  // The shortest backoff, only the locked TID holds the retry back.
+  tables[0]->Put(4, record);
+  tid_ptr = (volatile uint64_t*)tables[0]->Get(4);
+  set_backoff(1);
+  schedule_retry(action, 4, 1);
+  ASSERT_TRUE(conflict_ptr(action) == tid_ptr);
+  ASSERT_TRUE(deferred(action));
+  ASSERT_TRUE(deferred(action));
+
+  // The holder commits, and installs a new TID.
+  *tid_ptr = CREATE_TID(2, 0);
+  ASSERT_FALSE(deferred(action));
+  ASSERT_TRUE(conflict_ptr(action) == NULL);
+
+  // A retry_at in the future defers the retry by itself.
+  retry_at(action) = rdtsc() + (((uint64_t)1) << 40);
+  ASSERT_TRUE(deferred(action));
+}
+
+TEST_F(OCCWorkerTest, idleAdvanceTest) {
+  const uint32_t deadlines = 100;
+  const uint64_t never = ((uint64_t)1) << 62;
+  volatile uint64_t deadline = never;
+  std::atomic<bool> done(false);
+  OCCWorker *workers[2];
+  std::thread threads[2];
+  uint32_t i, start;
+
+  // Each advance pushes the next deadline out of reach, the test brings it
+  // back once per round, and both idle workers race to advance.
+  for (i = 0; i < 2; ++i) {
+    workers[i] = make_epoch_worker(&deadline, never);
+    threads[i] = std::thread([this, &done, &workers, i](){
+      while (!done)
+        txn_boundary(workers[i]);
+    });
+  }
+  start = epoch;
+  for (i = 0; i < deadlines; ++i) {
+    deadline = 0;
+    while (deadline < never || deadline == OCC_NO_DEADLINE)
+      std::this_thread::yield();
+    ASSERT_EQ(start + i + 1, epoch);
+  }
+  done = true;
+  for (i = 0; i < 2; ++i)
+    threads[i].join();
+  ASSERT_EQ(start + deadlines, epoch);
+}
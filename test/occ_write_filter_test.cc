@@ -0,0 +1,65 @@
+#include "gtest/gtest.h"
+#include "occ_write_filter.h"
+
+class OCCWriteFilterTest : public testing::Test {
+protected:
+  OCCWriteFilter *filter;
+
+  virtual void SetUp() {
+    filter = new(0) OCCWriteFilter(16);
+  }
+
+  // Advance the way an epoch manager does, from epoch to epoch+1.
+  void advance(uint32_t epoch) {
+    filter->Prepare(epoch + 2);
+  }
+};
+
+TEST_F(OCCWriteFilterTest, insertTest) {
+  uint64_t i;
+
+  filter->Insert(0, 0, 10);
+  filter->Insert(1, 1, 20);
+  ASSERT_TRUE(filter->MayContain(0, 0, 0, 10));
+  ASSERT_TRUE(filter->MayContain(0, 1, 1, 20));
+  ASSERT_FALSE(filter->MayContain(0, 0, 1, 20));
+
+  // Other keys only show up as false positives, which are rare here.
+  uint32_t false_positives = 0;
+  for (i = 100; i < 1100; ++i)
+    if (filter->MayContain(0, 1, 0, i))
+      false_positives += 1;
+  ASSERT_LT(false_positives, 10U);
+}
+
+TEST_F(OCCWriteFilterTest, coversTest) {
+  uint32_t epoch;
+
+  // Only epochs 0 and 1 are ready before the first advance.
+  ASSERT_TRUE(filter->Covers(0, 1));
+  ASSERT_FALSE(filter->Covers(0, 2));
+  for (epoch = 0; epoch < 10; ++epoch)
+    advance(epoch);
+  ASSERT_TRUE(filter->Covers(7, 11));
+
+  // Filters of old epochs have been recycled.
+  ASSERT_FALSE(filter->Covers(3, 5));
+  ASSERT_FALSE(filter->Covers(11, 10));
+}
+
+TEST_F(OCCWriteFilterTest, recycleTest) {
+  uint32_t epoch;
+
+  filter->Insert(1, 0, 10);
+  for (epoch = 0; epoch < 8; ++epoch)
+    advance(epoch);
+
+  // Epoch 9 reuses epoch 1's filter, which starts out empty.
+  ASSERT_FALSE(filter->Covers(1, 1));
+  ASSERT_TRUE(filter->Covers(9, 9));
+  ASSERT_FALSE(filter->MayContain(9, 9, 0, 10));
+
+  // Writers from a recycled epoch don't touch the new filter.
+  filter->Insert(1, 0, 10);
+  ASSERT_FALSE(filter->MayContain(9, 9, 0, 10));
+}
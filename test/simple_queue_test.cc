@@ -0,0 +1,62 @@
+#include "gtest/gtest.h"
+#include "concurrent_queue.h"
+
+#include <vector>
+#include <thread>
+#include <chrono>
+
+// NOTE:
+//    All of the tests of SimpleQueues are done using integers for simplicity.
+//    Every test runs with both spinning and parking queues.
+
+class SimpleQueueTest : public testing::TestWithParam<bool> {
+protected:
+  static const uint64_t size = 4;
+  std::vector<char> values;
+  std::shared_ptr<SimpleQueue<int>> queue;
+
+  virtual void SetUp() {
+    values.resize(size * CACHE_LINE);
+    queue = std::make_shared<SimpleQueue<int>>(values.data(), size, GetParam());
+  }
+};
+
+TEST_P(SimpleQueueTest, fifoTest) {
+  int val;
+  ASSERT_TRUE(queue->isEmpty());
+  for (int i = 0; i < (int)size; i++) {
+    ASSERT_TRUE(queue->Enqueue(i));
+  }
+  ASSERT_FALSE(queue->Enqueue(size));
+  for (int i = 0; i < (int)size; i++) {
+    ASSERT_TRUE(queue->Dequeue(&val));
+    ASSERT_EQ(i, val);
+  }
+  ASSERT_FALSE(queue->Dequeue(&val));
+}
+
+TEST_P(SimpleQueueTest, blockingTest) {
+  const int count = 200;
+  std::vector<int> taken;
+
+  // the queue is much smaller than count, so both sides block repeatedly,
+  // and the consumer blocks first because the producer starts late.
+  std::thread consumer([this, &taken](){
+    for (int i = 0; i < count; i++) {
+      taken.push_back(queue->DequeueBlocking());
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  for (int i = 0; i < count; i++) {
+    queue->EnqueueBlocking(i);
+  }
+  consumer.join();
+
+  ASSERT_EQ((size_t)count, taken.size());
+  for (int i = 0; i < count; i++) {
+    ASSERT_EQ(i, taken[i]);
+  }
+  ASSERT_TRUE(queue->isEmpty());
+}
+
+INSTANTIATE_TEST_CASE_P(WaitModes, SimpleQueueTest, testing::Bool());
@@ -0,0 +1,173 @@
+#include "gtest/gtest.h"
+#include "concurrent_queue.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+
+// NOTE:
+//    All of the tests of WorkStealingDeques are done using integers for
+//    simplicity.
+
+class WorkStealingDequeTest : public testing::Test {
+protected:
+  static const uint64_t size = 128;
+  int values[size];
+  std::shared_ptr<WorkStealingDeque<int>> deque;
+
+  virtual void SetUp() {
+    deque = std::make_shared<WorkStealingDeque<int>>(values, size);
+  }
+};
+
+TEST_F(WorkStealingDequeTest, constructorTest) {
+  int val;
+  ASSERT_TRUE(deque->isEmpty());
+  ASSERT_FALSE(deque->Pop(&val));
+  ASSERT_FALSE(deque->Steal(&val));
+  ASSERT_TRUE(deque->isEmpty());
+}
+
+TEST_F(WorkStealingDequeTest, popIsLIFOTest) {
+  int val;
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(deque->Push(i));
+  }
+
+  for (int i = 9; i >= 0; i--) {
+    ASSERT_TRUE(deque->Pop(&val));
+    ASSERT_EQ(i, val);
+  }
+  ASSERT_TRUE(deque->isEmpty());
+  ASSERT_FALSE(deque->Pop(&val));
+}
+
+TEST_F(WorkStealingDequeTest, stealIsFIFOTest) {
+  int val;
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(deque->Push(i));
+  }
+
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(deque->Steal(&val));
+    ASSERT_EQ(i, val);
+  }
+  ASSERT_TRUE(deque->isEmpty());
+  ASSERT_FALSE(deque->Steal(&val));
+}
+
+TEST_F(WorkStealingDequeTest, pushFullTest) {
+  int val;
+  for (int i = 0; i < (int)size; i++) {
+    ASSERT_TRUE(deque->Push(i));
+  }
+  ASSERT_FALSE(deque->Push(size));
+
+  // stealing an element frees a slot, and the ring wraps around.
+  ASSERT_TRUE(deque->Steal(&val));
+  ASSERT_EQ(0, val);
+  ASSERT_TRUE(deque->Push(size));
+  ASSERT_TRUE(deque->Pop(&val));
+  ASSERT_EQ((int)size, val);
+}
+
+TEST_F(WorkStealingDequeTest, concurrentPopStealTest) {
+  const int rounds = 1000;
+  const int thieves = 3;
+  std::vector<std::atomic<int>> taken(rounds * size);
+  std::atomic<bool> done(false);
+  std::thread thief_threads[thieves];
+
+  for (auto& t : taken) t = 0;
+  for (int i = 0; i < thieves; i++) {
+    thief_threads[i] = std::thread([this, &taken, &done](){
+      int val;
+      while (!done) {
+        if (deque->Steal(&val)) taken[val]++;
+      }
+    });
+  }
+
+  // the owner refills the deque and races the thieves to drain it.
+  int val;
+  for (int r = 0; r < rounds; r++) {
+    for (uint64_t i = 0; i < size; i++) {
+      ASSERT_TRUE(deque->Push(r * size + i));
+    }
+    while (!deque->isEmpty()) {
+      if (deque->Pop(&val)) taken[val]++;
+    }
+  }
+  done = true;
+  for (int i = 0; i < thieves; i++) {
+    thief_threads[i].join();
+  }
+
+  // every element is taken exactly once.
+  for (auto& t : taken) {
+    ASSERT_EQ(1, t);
+  }
+}
+
+TEST_F(WorkStealingDequeTest, stealIfTest) {
+  int val;
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(deque->Push(i));
+  }
+
+  // a rejected element stays at the top of the deque.
+  ASSERT_FALSE(deque->StealIf(&val, [](int v) { return v != 0; }));
+  ASSERT_TRUE(deque->StealIf(&val, [](int v) { return v == 0; }));
+  ASSERT_EQ(0, val);
+  ASSERT_TRUE(deque->Pop(&val));
+  ASSERT_EQ(3, val);
+}
+
+TEST_F(WorkStealingDequeTest, concurrentEpochStealTest) {
+  const int epochs = 1000;
+  const int thieves = 3;
+  std::vector<std::atomic<int>> taken(epochs * size);
+  std::atomic<int> foreign(0);
+  std::atomic<int> epoch(0);
+  std::atomic<bool> done(false);
+  std::thread thief_threads[thieves];
+
+  // element i*size + j belongs to epoch i.
+  for (auto& t : taken) t = 0;
+  for (int i = 0; i < thieves; i++) {
+    thief_threads[i] = std::thread([this, &taken, &foreign, &epoch, &done](){
+      int val, my_epoch;
+      while (!done) {
+        my_epoch = epoch;
+        if (deque->StealIf(&val, [my_epoch](int v) {
+              return v / (int)size == my_epoch;
+            })) {
+          if (val / (int)size != my_epoch) foreign++;
+          taken[val]++;
+        }
+      }
+    });
+  }
+
+  // the owner moves to the next epoch as soon as its deque is empty, while 
+  // thieves may still be trying to steal for the previous one.
+  int val;
+  for (int e = 0; e < epochs; e++) {
+    epoch = e;
+    for (uint64_t i = 0; i < size; i++) {
+      ASSERT_TRUE(deque->Push(e * size + i));
+    }
+    while (!deque->isEmpty()) {
+      if (deque->Pop(&val)) taken[val]++;
+    }
+  }
+  done = true;
+  for (int i = 0; i < thieves; i++) {
+    thief_threads[i].join();
+  }
+
+  ASSERT_EQ(0, foreign);
+  for (auto& t : taken) {
+    ASSERT_EQ(1, t);
+  }
+}